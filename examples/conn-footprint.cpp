@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <string>
+#include <cstdlib>
+#include <malloc.h>
+#include <iomultiplex.hpp>
+
+using namespace std;
+namespace iom = iomultiplex;
+
+
+//------------------------------------------------------------------------------
+// Bytes currently allocated on the heap
+//------------------------------------------------------------------------------
+static size_t heap_in_use ()
+{
+    auto mi = mallinfo2 ();
+    return mi.uordblks + mi.hblkhd;
+}
+
+
+//------------------------------------------------------------------------------
+// Allocate 'num' connections created by 'make_conn' and
+// return the average heap usage per connection.
+//------------------------------------------------------------------------------
+template<typename T>
+static size_t measure (size_t num, std::function<T* ()> make_conn)
+{
+    std::vector<std::unique_ptr<T>> conns;
+    conns.reserve (num);
+    auto before = heap_in_use ();
+    for (size_t i=0; i<num; ++i)
+        conns.emplace_back (make_conn());
+    auto after = heap_in_use ();
+    return (after - before) / num;
+}
+
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+template<typename T>
+static void print (const std::string& name, size_t heap_per_conn)
+{
+    cout << left << setw(24) << name
+         << right << setw(8) << sizeof(T)
+         << setw(12) << heap_per_conn << endl;
+}
+
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+int main (int argc, char* argv[])
+{
+    size_t num = 10000;
+    if (argc > 1)
+        num = strtoul (argv[1], nullptr, 0);
+    if (!num) {
+        cerr << "Usage: conn-footprint [number_of_connections]" << endl;
+        return 1;
+    }
+
+    iom::default_iohandler ioh;
+
+    cout << "Memory footprint per connection object, average of "
+         << num << " objects" << endl << endl;
+    cout << left << setw(24) << "Type"
+         << right << setw(8) << "sizeof"
+         << setw(12) << "heap" << endl;
+
+    print<iom::FdConnection> ("FdConnection",
+                              measure<iom::FdConnection>(num, [&ioh]{
+                                  return new iom::FdConnection (ioh);
+                              }));
+    print<iom::SocketConnection> ("SocketConnection",
+                                  measure<iom::SocketConnection>(num, [&ioh]{
+                                      return new iom::SocketConnection (ioh);
+                                  }));
+    print<iom::TimerConnection> ("TimerConnection",
+                                 measure<iom::TimerConnection>(num, [&ioh]{
+                                     return new iom::TimerConnection (ioh);
+                                 }));
+    print<iom::SerialConnection> ("SerialConnection",
+                                  measure<iom::SerialConnection>(num, [&ioh]{
+                                      return new iom::SerialConnection (ioh);
+                                  }));
+    cout << endl << "The heap column includes the object itself." << endl;
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <ctime>
+#include <iomultiplex.hpp>
+
+using namespace std;
+namespace iom = iomultiplex;
+
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static string flags_str (uint8_t flags)
+{
+    string str;
+    if (flags & iom::FlightRecorder::flag_rx)
+        str += "rx";
+    if (flags & iom::FlightRecorder::flag_tx)
+        str += str.empty() ? "tx" : ",tx";
+    if (flags & iom::FlightRecorder::flag_fast)
+        str += str.empty() ? "fast" : ",fast";
+    return str.empty() ? string("-") : str;
+}
+
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+int main (int argc, char* argv[])
+{
+    if (argc < 2) {
+        cerr << "Usage: flight-dump <dump file>" << endl;
+        cerr << endl;
+        cerr << "Decode and print a dump made by iomultiplex::FlightRecorder." << endl;
+        cerr << endl;
+        return 1;
+    }
+
+    vector<iom::FlightRecorder::record_t> records;
+    iom::FlightRecorder::dump_info_t info;
+    if (iom::FlightRecorder::load(argv[1], records, info)) {
+        cerr << "Error: " << argv[1] << ": " << strerror(errno) << endl;
+        return 1;
+    }
+
+    // Print the time of the dump
+    //
+    time_t dump_time = info.real_time / 1000000000;
+    struct tm tm;
+    char time_buf[64];
+    strftime (time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", localtime_r(&dump_time, &tm));
+    cout << "Dumped at " << time_buf
+         << ", " << info.recorded << " events recorded"
+         << ", " << records.size() << " of " << info.capacity << " entries in dump"
+         << endl;
+
+    // Print each event, with the time relative to the dump
+    //
+    cout << setw(12) << "seq" << ' '
+         << setw(16) << "time_ms" << ' '
+         << setw(8) << "event" << ' '
+         << setw(6) << "fd" << ' '
+         << setw(12) << "flags" << ' '
+         << setw(10) << "size" << ' '
+         << setw(10) << "result" << ' '
+         << "error" << endl;
+    for (auto& rec : records) {
+        double rel_ms = ((double)rec.time - (double)info.mono_time) / 1000000.0;
+        cout << setw(12) << rec.seq << ' '
+             << setw(16) << fixed << setprecision(3) << rel_ms << ' '
+             << setw(8) << iom::FlightRecorder::event_name(rec.event) << ' '
+             << setw(6) << rec.fd << ' '
+             << setw(12) << flags_str(rec.flags) << ' '
+             << setw(10) << rec.size << ' '
+             << setw(10) << rec.result << ' '
+             << (rec.errnum ? strerror(rec.errnum) : "-") << endl;
+    }
+
+    return 0;
+}
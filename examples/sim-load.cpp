@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <iomultiplex.hpp>
+
+using namespace std;
+namespace iom = iomultiplex;
+
+
+static constexpr size_t msg_size = 100;
+static constexpr uint64_t ns_per_ms = 1000000;
+
+
+//------------------------------------------------------------------------------
+// A client and a server connected by a simulated link.
+// The client sends a request every interval, the server echoes it back.
+//------------------------------------------------------------------------------
+struct session_t {
+    session_t (iom::SimIOHandler& ioh)
+        : client (ioh),
+          server (ioh),
+          client_rx (client),
+          server_rx (server)
+    {
+        client.connect (server);
+    }
+    iom::SimConnection client;
+    iom::SimConnection server;
+    iom::ChunkAdapter client_rx;
+    iom::ChunkAdapter server_rx;
+    char client_buf[msg_size];
+    char server_buf[msg_size];
+    uint64_t sent_at {0};
+};
+
+
+static uint64_t num_replies = 0;
+static uint64_t sum_rtt = 0;
+static uint64_t max_rtt = 0;
+
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static void serve (iom::SimIOHandler& ioh, session_t& s)
+{
+    s.server_rx.read (s.server_buf, msg_size, 1, [&ioh, &s](iom::io_result_t& ior)->bool{
+            if (ior.result > 0) {
+                s.server.write (s.server_buf, msg_size, nullptr);
+                serve (ioh, s);
+            }
+            return false;
+        });
+}
+
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static void request (iom::SimIOHandler& ioh, session_t& s, uint64_t interval, uint64_t end_time)
+{
+    if (ioh.now() >= end_time)
+        return;
+    s.sent_at = ioh.now ();
+    s.client.write (s.client_buf, msg_size, nullptr);
+    s.client_rx.read (s.client_buf, msg_size, 1,
+                      [&ioh, &s, interval, end_time](iom::io_result_t& ior)->bool{
+            if (ior.result <= 0)
+                return false;
+            auto rtt = ioh.now() - s.sent_at;
+            ++num_replies;
+            sum_rtt += rtt;
+            if (rtt > max_rtt)
+                max_rtt = rtt;
+            ioh.schedule (interval, [&ioh, &s, interval, end_time]{
+                    request (ioh, s, interval, end_time);
+                });
+            return false;
+        });
+}
+
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+int main (int argc, char* argv[])
+{
+    if (argc > 1 && (string(argv[1]) == "-h" || string(argv[1]) == "--help")) {
+        cerr << "Usage: sim-load [connections] [seconds] [latency_ms] [loss]" << endl;
+        cerr << endl;
+        cerr << "Simulate clients sending a request each second to" << endl;
+        cerr << "an echo server, using virtual time." << endl;
+        cerr << endl;
+        return 0;
+    }
+    size_t num_sessions = argc > 1 ? stoul (argv[1]) : 10000;
+    uint64_t seconds    = argc > 2 ? stoul (argv[2]) : 3600;
+    uint64_t latency    = argc > 3 ? stoul (argv[3]) : 20;
+    double loss         = argc > 4 ? stod (argv[4]) : 0.001;
+
+    iom::SimIOHandler ioh;
+    auto link = iom::SimIOHandler::default_link_props;
+    link.latency = latency * ns_per_ms;
+    link.bandwidth = 1000000; // 1 MB/s per direction and connection
+    link.loss = loss;
+    ioh.default_link (link);
+
+    auto wall_start = chrono::steady_clock::now ();
+
+    // Start the sessions spread out over the first second
+    vector<unique_ptr<session_t>> sessions;
+    sessions.reserve (num_sessions);
+    uint64_t end_time = seconds * 1000 * ns_per_ms;
+    for (size_t i=0; i<num_sessions; ++i) {
+        sessions.emplace_back (new session_t(ioh));
+        auto& s = *sessions.back ();
+        serve (ioh, s);
+        ioh.schedule (i * 1000 * ns_per_ms / num_sessions, [&ioh, &s, end_time]{
+                request (ioh, s, 1000 * ns_per_ms, end_time);
+            });
+    }
+
+    ioh.run ();
+
+    chrono::duration<double> wall = chrono::steady_clock::now() - wall_start;
+    iom::SimIOHandler::stats_t stats;
+    ioh.stats (stats);
+
+    cout << "Simulated " << num_sessions << " sessions for "
+         << (ioh.now() / ns_per_ms / 1000) << " seconds in "
+         << fixed << setprecision(2) << wall.count() << " seconds" << endl;
+    cout << "Replies: " << num_replies
+         << ", average RTT: " << (num_replies ? sum_rtt / num_replies / 1000 : 0) << " us"
+         << ", max RTT: " << (max_rtt / 1000) << " us" << endl;
+    cout << "Events: " << stats.events
+         << ", callbacks: " << stats.callbacks
+         << ", bytes: " << stats.bytes_recv
+         << ", lost: " << stats.lost << endl;
+
+    // Close all connections before the I/O handler is destroyed
+    sessions.clear ();
+    return 0;
+}
@@ -65,6 +65,24 @@ namespace iomultiplex {
     }
 
 
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    size_t BufferPool::capacity ()
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        return chunks.size ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    size_t BufferPool::in_use ()
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        return top;
+    }
+
+
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
     void* BufferPool::get ()
@@ -108,6 +108,18 @@ namespace iomultiplex {
          */
         const size_t pool_size ();
 
+        /**
+         * Return the number of buffers allocated by the buffer pool.
+         * @return The number of buffers, in use or not.
+         */
+        size_t capacity ();
+
+        /**
+         * Return the number of buffers currently in use.
+         * @return The number of buffers taken from the pool and not yet returned.
+         */
+        size_t in_use ();
+
 
     private:
         const size_t chunk_size;
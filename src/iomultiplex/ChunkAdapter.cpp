@@ -28,6 +28,19 @@
 namespace iomultiplex {
 
 
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void ChunkAdapter::set_rx_low_watermark (size_t bytes)
+    {
+        if (!use_lowat || !slave || bytes==cur_lowat)
+            return;
+        if (slave->rx_low_watermark(bytes) == 0)
+            cur_lowat = bytes;
+        else if (errno == ENOTSUP)
+            use_lowat = false; // Not supported by the slave connection
+    }
+
+
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
     bool ChunkAdapter::chunk_rx_cb (io_result_t& ior,
@@ -39,6 +52,7 @@ namespace iomultiplex {
                                     unsigned timeout)
     {
         if (ior.result <= 0) {
+            set_rx_low_watermark (1);
             ior.buf = buf; // Return the original buf pointer
             // Let's take what we have in our buffer, if any
             ssize_t result = (ssize_t) (cur_size / chunk_size);
@@ -61,6 +75,7 @@ namespace iomultiplex {
         }
         else if (cur_size + (size_t)ior.result == tot_size) {
             // We have just enough data
+            set_rx_low_watermark (1);
             ior.buf = buf;
             ior.size = tot_size;
             ior.result = tot_size / chunk_size;
@@ -68,7 +83,9 @@ namespace iomultiplex {
         }
         else {
             // We need more data !
+            // Don't wake up until all of it is available.
             cur_size += (size_t) ior.result;
+            set_rx_low_watermark (tot_size - cur_size);
             Adapter::read (((char*)ior.buf) + ior.result,
                            tot_size-cur_size,
                            [this,
@@ -99,7 +116,9 @@ namespace iomultiplex {
         : rx_buf_size (0),
           tx_buf_size (0),
           rx_buf_pos  (0),
-          tx_buf_pos  (0)
+          tx_buf_pos  (0),
+          use_lowat   (false),
+          cur_lowat   (1)
     {
     }
 
@@ -111,7 +130,9 @@ namespace iomultiplex {
           rx_buf_size (0),
           tx_buf_size (0),
           rx_buf_pos  (0),
-          tx_buf_pos  (0)
+          tx_buf_pos  (0),
+          use_lowat   (false),
+          cur_lowat   (1)
     {
     }
 
@@ -123,7 +144,9 @@ namespace iomultiplex {
           rx_buf_size (0),
           tx_buf_size (0),
           rx_buf_pos  (0),
-          tx_buf_pos  (0)
+          tx_buf_pos  (0),
+          use_lowat   (false),
+          cur_lowat   (1)
     {
     }
 
@@ -219,6 +242,8 @@ namespace iomultiplex {
             errno = EDEADLK;
             return -1;
         }
+
+        auto& sync = sync_state ();
         ssize_t result = -1;
         bool io_done = false;
         int errnum = 0;
@@ -226,20 +251,20 @@ namespace iomultiplex {
         if (read(buf,
                  chunk_size,
                  num_chunks,
-                 [this, &result, &io_done, &errnum](io_result_t& ior)->bool{
+                 [&result, &io_done, &errnum, &sync](io_result_t& ior)->bool{
                      // Called from iohandler_base
-                     std::unique_lock<std::mutex> lock (sync_mutex);
+                     std::unique_lock<std::mutex> lock (sync.mutex);
                      result = ior.result;
                      errnum = ior.errnum;
                      io_done = true;
-                     sync_cond.notify_one ();
+                     sync.cond.notify_one ();
                      return false;
                  },
                  timeout) == 0)
         {
             // Wait for the read operation to finish or timeout
-            std::unique_lock<std::mutex> lock (sync_mutex);
-            sync_cond.wait (lock, [&io_done]{return io_done;});
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&io_done]{return io_done;});
             errno = errnum;
         }
         return result;
@@ -343,6 +368,8 @@ namespace iomultiplex {
             errno = EDEADLK;
             return -1;
         }
+
+        auto& sync = sync_state ();
         ssize_t result = -1;
         bool io_done = false;
         int errnum = 0;
@@ -350,20 +377,20 @@ namespace iomultiplex {
         if (write(buf,
                   chunk_size,
                   num_chunks,
-                  [this, &result, &io_done, &errnum](io_result_t& ior)->bool{
+                  [&result, &io_done, &errnum, &sync](io_result_t& ior)->bool{
                       // Called from iohandler_base
-                      std::unique_lock<std::mutex> lock (sync_mutex);
+                      std::unique_lock<std::mutex> lock (sync.mutex);
                       result = ior.result;
                       errnum = ior.errnum;
                       io_done = true;
-                      sync_cond.notify_one ();
+                      sync.cond.notify_one ();
                       return false;
                   },
                   timeout) == 0)
         {
             // Wait for the write operation to finish or timeout
-            std::unique_lock<std::mutex> lock (sync_mutex);
-            sync_cond.wait (lock, [&io_done]{return io_done;});
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&io_done]{return io_done;});
             errno = errnum;
         }
         return result;
@@ -381,6 +408,7 @@ namespace iomultiplex {
                 rx_buf.reset ();
             rx_buf_size = 0;
             rx_buf_pos = 0;
+            set_rx_low_watermark (1);
         }
         if (cancel_tx) {
             if (tx_buf)
@@ -167,8 +167,29 @@ namespace iomultiplex {
                              bool cancel_tx=true,
                              bool fast=false);
 
+        /**
+         * Use a receive low watermark for partially read chunks.
+         * When enabled, and only part of the requested chunks
+         * are available, the low watermark of the slave connection
+         * is set to the number of bytes still missing. The slave
+         * connection is then not reported readable until the
+         * rest of the data is available, instead of waking up
+         * for each fragment that arrives.
+         * The low watermark is restored when the read is done.
+         * <br/>
+         * If the slave connection doesn't support a low watermark,
+         * this setting has no effect.
+         * @param enable <code>true</code> to use a low watermark.
+         * @see Connection::rx_low_watermark
+         */
+        void use_rx_low_watermark (bool enable) {
+            use_lowat = enable;
+        }
+
 
     private:
+        void set_rx_low_watermark (size_t bytes);
+
         bool chunk_rx_cb (io_result_t& ior,
                           void* buf,
                           size_t tot_size,
@@ -189,6 +210,8 @@ namespace iomultiplex {
         size_t tx_buf_size;
         size_t rx_buf_pos;
         size_t tx_buf_pos;
+        bool use_lowat;
+        size_t cur_lowat;
     };
 
 
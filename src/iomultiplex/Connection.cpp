@@ -18,6 +18,7 @@
  */
 #include <iomultiplex/Connection.hpp>
 #include <iomultiplex/iohandler_base.hpp>
+#include <iomultiplex/BufferPool.hpp>
 #include <cerrno>
 #include <unistd.h>
 
@@ -26,11 +27,25 @@ namespace iomultiplex {
 
 
 
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    Connection::sync_state_t& Connection::sync_state ()
+    {
+        static thread_local sync_state_t state;
+        return state;
+    }
+
+
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
     void Connection::default_rx_callback (io_callback_t rx_cb)
     {
-        def_rx_cb = rx_cb;
+        if (!def_cbs) {
+            if (rx_cb == nullptr)
+                return;
+            def_cbs = std::make_unique<default_cbs_t> ();
+        }
+        def_cbs->rx = rx_cb;
     }
 
 
@@ -38,7 +53,30 @@ namespace iomultiplex {
     //--------------------------------------------------------------------------
     void Connection::default_tx_callback (io_callback_t tx_cb)
     {
-        def_tx_cb = tx_cb;
+        if (!def_cbs) {
+            if (tx_cb == nullptr)
+                return;
+            def_cbs = std::make_unique<default_cbs_t> ();
+        }
+        def_cbs->tx = tx_cb;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    const io_callback_t& Connection::def_rx_cb () const
+    {
+        static const io_callback_t no_cb {nullptr};
+        return def_cbs ? def_cbs->rx : no_cb;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    const io_callback_t& Connection::def_tx_cb () const
+    {
+        static const io_callback_t no_cb {nullptr};
+        return def_cbs ? def_cbs->tx : no_cb;
     }
 
 
@@ -54,7 +92,7 @@ namespace iomultiplex {
         return io_handler().read (*this,
                                   buf,
                                   size,
-                                  rx_cb != nullptr ? rx_cb : def_rx_cb,
+                                  rx_cb != nullptr ? rx_cb : def_rx_cb(),
                                   timeout);
     }
 
@@ -71,32 +109,100 @@ namespace iomultiplex {
             errno = EDEADLK;
             return -1;
         }
+        auto& sync = sync_state ();
         ssize_t result = -1;
         bool io_done = false;
         int errnum = 0;
         // Queue a read operation
         if (read(buf,
                  size,
-                 [this, &result, &io_done, &errnum](io_result_t& ior)->bool{
+                 [&result, &io_done, &errnum, &sync](io_result_t& ior)->bool{
                      // Called from iohandler_base
-                     std::unique_lock<std::mutex> lock (sync_mutex);
+                     std::unique_lock<std::mutex> lock (sync.mutex);
                      result = ior.result;
                      errnum = ior.errnum;
                      io_done = true;
-                     sync_cond.notify_one ();
+                     sync.cond.notify_one ();
                      return false;
                  },
                  timeout) == 0)
         {
             // Wait for the read operation to finish or timeout
-            std::unique_lock<std::mutex> lock (sync_mutex);
-            sync_cond.wait (lock, [&io_done]{return io_done;});
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&io_done]{return io_done;});
             errno = errnum;
         }
         return result;
     }
 
 
+    //--------------------------------------------------------------------------
+    // Asynchronized operation, buffer taken from a pool when data is available
+    //--------------------------------------------------------------------------
+    int Connection::read (BufferPool& pool,
+                          io_callback_t rx_cb,
+                          unsigned timeout)
+    {
+        auto io_cb = rx_cb != nullptr ? rx_cb : def_rx_cb();
+        return wait_for_rx ([this, &pool, io_cb, timeout](io_result_t& ior)->bool{
+                return pool_rx_cb (ior, pool, io_cb, timeout);
+            },
+            timeout);
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Called in I/O handler context
+    //--------------------------------------------------------------------------
+    bool Connection::pool_rx_cb (io_result_t& ior,
+                                 BufferPool& pool,
+                                 io_callback_t rx_cb,
+                                 unsigned timeout)
+    {
+        ior.buf = nullptr;
+        ior.size = 0;
+        if (ior.result < 0)
+            return rx_cb ? rx_cb(ior) : false; // Error, timeout, or cancelled
+
+        void* buf = pool.get ();
+        if (buf == nullptr) {
+            ior.result = -1;
+            ior.errnum = ENOBUFS;
+            return rx_cb ? rx_cb(ior) : false;
+        }
+
+        ior.result = do_read (buf, pool.buf_size(), ior.errnum);
+        if (ior.result < 0 && (ior.errnum==EAGAIN || ior.errnum==EWOULDBLOCK)) {
+            // Nothing to read after all, wait again
+            pool.put (buf);
+            if (wait_for_rx([this, &pool, rx_cb, timeout](io_result_t& ior)->bool{
+                        return pool_rx_cb (ior, pool, rx_cb, timeout);
+                    },
+                    timeout))
+            {
+                ior.result = -1;
+                ior.errnum = errno;
+                return rx_cb ? rx_cb(ior) : false;
+            }
+            return false;
+        }
+
+        if (ior.result <= 0) {
+            pool.put (buf);
+        }else{
+            ior.buf = buf;
+            ior.size = pool.buf_size ();
+        }
+        if (rx_cb) {
+            return rx_cb (ior);
+        }else{
+            if (ior.buf)
+                pool.put (ior.buf); // Nobody to hand over the buffer to
+            return false;
+        }
+    }
+
+
     //--------------------------------------------------------------------------
     // Asynchronized operation
     //--------------------------------------------------------------------------
@@ -109,7 +215,7 @@ namespace iomultiplex {
         return io_handler().write (*this,
                            buf,
                            size,
-                           tx_cb != nullptr ? tx_cb : def_tx_cb,
+                           tx_cb != nullptr ? tx_cb : def_tx_cb(),
                            timeout);
     }
 
@@ -126,26 +232,27 @@ namespace iomultiplex {
             errno = EDEADLK;
             return -1;
         }
+        auto& sync = sync_state ();
         ssize_t result = -1;
         bool io_done = false;
         int errnum = 0;
         // Queue a write operation
         if (write(buf,
                   size,
-                  [this, &result, &io_done, &errnum](io_result_t& ior)->bool{
+                  [&result, &io_done, &errnum, &sync](io_result_t& ior)->bool{
                       // Called from iohandler_base
-                      std::unique_lock<std::mutex> lock (sync_mutex);
+                      std::unique_lock<std::mutex> lock (sync.mutex);
                       result = ior.result;
                       errnum = ior.errnum;
                       io_done = true;
-                      sync_cond.notify_one ();
+                      sync.cond.notify_one ();
                       return false;
                   },
                   timeout) == 0)
         {
             // Wait for the write operation to finish or timeout
-            std::unique_lock<std::mutex> lock (sync_mutex);
-            sync_cond.wait (lock, [&io_done]{return io_done;});
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&io_done]{return io_done;});
             errno = errnum;
         }
         return result;
@@ -161,7 +268,7 @@ namespace iomultiplex {
         return io_handler().read (*this,
                           nullptr,
                           0,
-                          rx_cb != nullptr ? rx_cb : def_rx_cb,
+                          rx_cb != nullptr ? rx_cb : def_rx_cb(),
                           timeout,
                           true);
     }
@@ -177,24 +284,25 @@ namespace iomultiplex {
             errno = EDEADLK;
             return -1;
         }
+        auto& sync = sync_state ();
         int retval = -1;
         int errnum = 0;
         bool io_done = false;
         // Queue a dummy read operation
-        if (wait_for_rx([this, &retval, &errnum, &io_done](io_result_t& ior)->bool{
+        if (wait_for_rx([&retval, &errnum, &io_done, &sync](io_result_t& ior)->bool{
                     // Called from iohandler_base
-                    std::unique_lock<std::mutex> lock (sync_mutex);
+                    std::unique_lock<std::mutex> lock (sync.mutex);
                     retval = ior.result;
                     errnum = ior.errnum;
-                    sync_cond.notify_one ();
+                    sync.cond.notify_one ();
                     io_done = true;
                     return false;
                 },
                 timeout) == 0)
         {
             // Dummy read operation queued, wait for result
-            std::unique_lock<std::mutex> lock (sync_mutex);
-            sync_cond.wait (lock, [&io_done]{return io_done;});
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&io_done]{return io_done;});
             errno = errnum;
         }
         return retval;
@@ -210,7 +318,7 @@ namespace iomultiplex {
         return io_handler().write (*this,
                            nullptr,
                            0,
-                           tx_cb != nullptr ? tx_cb : def_tx_cb,
+                           tx_cb != nullptr ? tx_cb : def_tx_cb(),
                            timeout,
                            true);
     }
@@ -226,27 +334,38 @@ namespace iomultiplex {
             errno = EDEADLK;
             return -1;
         }
+        auto& sync = sync_state ();
         int retval = -1;
         int errnum = 0;
         bool io_done = false;
-        if (wait_for_tx([this, &retval, &errnum, &io_done](io_result_t& ior)->bool{
+        if (wait_for_tx([&retval, &errnum, &io_done, &sync](io_result_t& ior)->bool{
                     // Called from iohandler_base
-                    std::unique_lock<std::mutex> lock (sync_mutex);
+                    std::unique_lock<std::mutex> lock (sync.mutex);
                     retval = ior.result;
                     errnum = ior.errnum;
                     io_done = true;
-                    sync_cond.notify_one ();
+                    sync.cond.notify_one ();
                     return false;
                 },
                 timeout) == 0)
         {
             // Dummy write operation queued, wait for result
-            std::unique_lock<std::mutex> lock (sync_mutex);
-            sync_cond.wait (lock, [&io_done]{return io_done;});
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&io_done]{return io_done;});
             errno = errnum;
         }
         return retval;
     }
 
 
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int Connection::rx_low_watermark (size_t /*bytes*/)
+    {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+
 }
@@ -23,13 +23,15 @@
 #include <iomultiplex/io_result_t.hpp>
 #include <condition_variable>
 #include <mutex>
+#include <memory>
 #include <cstdlib>
 
 
 namespace iomultiplex {
 
-    // Forward declaration
+    // Forward declarations
     class iohandler_base;
+    class BufferPool;
 
 
     /**
@@ -90,10 +92,10 @@ namespace iomultiplex {
          * This is done so allocated resources associated
          * with the I/O operation can be released.
          *
-         * @note Until all I/O queued operations are cancelled,
-         * trying to queue an I/O operation of the same type
-         * (RX and/or TX) will fail with <code>errno</code> being
-         * set to <code>ECANCELED</code>.
+         * @note Only I/O operations queued before this call are
+         * cancelled. I/O operations queued after this call, even
+         * before the callbacks of the cancelled operations are
+         * called, are not affected.
          *
          * @param cancel_rx If true, cancel all input operations.
          * @param cancel_tx If true, cancel all output operations.
@@ -111,6 +113,48 @@ namespace iomultiplex {
          */
         virtual void close () = 0;
 
+        /**
+         * Check if read readiness should wake only one I/O handler.
+         * When the same file is monitored by several I/O handlers,
+         * and this method returns <code>true</code>, an I/O handler
+         * that supports it will only wake up one of them when the
+         * file is ready to read (EPOLLEXCLUSIVE).
+         * Such connections can only queue read operations.
+         * @return <code>false</code> unless overridden.
+         */
+        virtual bool exclusive_wakeup () const {
+            return false;
+        }
+
+        /**
+         * Read pending messages in the error queue of the connection.
+         * Called by the I/O handler when an error condition, but no
+         * hangup, is reported on the file descriptor. A connection
+         * using the socket error queue, for example for transmit
+         * timestamps, reads it here so that it isn't reported as
+         * an error to the queued I/O operations.
+         * @return <code>true</code> if the error condition was
+         *         caused by the error queue and is now cleared.
+         *         <code>false</code> unless overridden.
+         */
+        virtual bool handle_error_queue () {
+            return false;
+        }
+
+        /**
+         * Set the minimum number of bytes needed to report the connection readable.
+         * With a low watermark set, the I/O handler is not woken up
+         * until at least this number of bytes can be read, or an
+         * error or end of file occurs. This reduces the number of
+         * wakeups when a caller needs a known amount of data, for
+         * example a full frame header.
+         * @param bytes The minimum number of bytes. 1 is the normal behaviour.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         *         If not supported by the connection, <code>errno</code>
+         *         is set to <code>ENOTSUP</code>.
+         */
+        virtual int rx_low_watermark (size_t bytes);
+
         /**
          * Set a default read operation callback function.
          * @param rx_cb A default read operation callback,
@@ -164,6 +208,42 @@ namespace iomultiplex {
          */
         ssize_t read (void* buf, size_t size, unsigned timeout=-1);
 
+        /**
+         * Queue a read operation using a buffer from a buffer pool.
+         * Unlike the other read methods, no buffer is bound to
+         * the operation while it waits. When data is available for
+         * reading, a buffer is taken from the pool and the data is
+         * read into it. This way, idle connections don't hold on
+         * to any buffers while waiting for data.
+         * <br/>
+         * On a successful read, <code>ior.buf</code> is the
+         * buffer from the pool and <code>ior.size</code> is the size
+         * of the buffer. The callback then owns the buffer and is
+         * responsible for putting it back to the pool using
+         * <code>BufferPool::put</code>.
+         * If nothing is read (<code>ior.result</code> <= 0), the
+         * buffer is put back before the callback is called, and
+         * <code>ior.buf</code> is <code>nullptr</code>.
+         * If the pool is out of buffers, the callback is called with
+         * <code>ior.result</code> set to -1 and <code>ior.errnum</code>
+         * set to <code>ENOBUFS</code>.
+         * @param pool The buffer pool to take a buffer from.
+         *             The pool must outlive the read operation.
+         * @param rx_cb If not <code>nullptr</code>, this callback
+         *              is called when the read operation has generated
+         *              a result.
+         *              <br/>
+         *              If <code>nullptr</code>, the default read
+         *              operation callback is called if one is set.
+         * @param timeout A timeout in milliseconds. If -1, no timeout is set.
+         * @return 0 on success, -1 if the file descriptor isn't valid.
+         *         <br/><b>Note:</b> A return value of 0 means that the
+         *         read operation was queued, not that the actual read
+         *         operation was successful.
+         * @see BufferPool
+         */
+        int read (BufferPool& pool, io_callback_t rx_cb, unsigned timeout=-1);
+
         /**
          * Queue a write operation.
          * This method queues a write operation and returns immediately.
@@ -290,12 +370,28 @@ namespace iomultiplex {
 
 
     protected:
-        io_callback_t def_rx_cb;
-        io_callback_t def_tx_cb;
-
-        // For synchronized I/O
-        std::mutex sync_mutex;
-        std::condition_variable sync_cond;
+        bool pool_rx_cb (io_result_t& ior,
+                         BufferPool& pool,
+                         io_callback_t rx_cb,
+                         unsigned timeout);
+
+        // Default callbacks, only allocated when one is set
+        struct default_cbs_t {
+            io_callback_t rx;
+            io_callback_t tx;
+        };
+        std::unique_ptr<default_cbs_t> def_cbs;
+        const io_callback_t& def_rx_cb () const;
+        const io_callback_t& def_tx_cb () const;
+
+        // For synchronized I/O.
+        // The state is per calling thread and not per connection
+        // since the calling thread is blocked until the I/O is done.
+        struct sync_state_t {
+            std::mutex mutex;
+            std::condition_variable cond;
+        };
+        static sync_state_t& sync_state ();
 
 
     private:
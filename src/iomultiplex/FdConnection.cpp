@@ -61,11 +61,12 @@ namespace iomultiplex {
     FdConnection::FdConnection (FdConnection&& conn)
     {
         conn.cancel ();
+        if (conn.ioh)
+            conn.ioh->forget (conn);
         fd  = conn.fd.exchange (-1);
         ioh = conn.ioh;
         conn.ioh = nullptr;
-        def_rx_cb = std::move (conn.def_rx_cb);
-        def_tx_cb = std::move (conn.def_tx_cb);
+        def_cbs = std::move (conn.def_cbs);
     }
 
 
@@ -75,6 +76,8 @@ namespace iomultiplex {
     {
         if (!keep_open && ioh)
             close ();
+        else if (ioh)
+            ioh->forget (*this);
     }
 
 
@@ -85,11 +88,12 @@ namespace iomultiplex {
         if (this != &rhs) {
             cancel ();
             rhs.cancel ();
+            if (rhs.ioh)
+                rhs.ioh->forget (rhs);
             fd  = rhs.fd.exchange (-1);
             ioh = rhs.ioh;
             rhs.ioh = nullptr;
-            def_rx_cb = std::move (rhs.def_rx_cb);
-            def_tx_cb = std::move (rhs.def_tx_cb);
+            def_cbs = std::move (rhs.def_cbs);
         }
         return *this;
     }
@@ -135,6 +139,8 @@ namespace iomultiplex {
     void FdConnection::close ()
     {
         cancel ();
+        if (ioh)
+            ioh->forget (*this);
         int tmp_fd = fd.exchange (-1);
         if (tmp_fd != -1)
             ::close (tmp_fd);
@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/FlightRecorder.hpp>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+
+
+namespace iomultiplex {
+
+
+    // Header of a binary dump, followed by 'capacity' entries
+    struct dump_header_t {
+        char     magic[8];
+        uint32_t version;
+        uint32_t entry_size;
+        uint32_t capacity;
+        uint32_t reserved;
+        uint64_t recorded;
+        uint64_t mono_time;
+        uint64_t real_time;
+    };
+
+    static constexpr char dump_magic[8] = {'I', 'O', 'M', 'F', 'L', 'T', 'R', '\0'};
+    static constexpr uint32_t dump_version = 1;
+    static constexpr uint32_t max_capacity = 1u << 24;
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    static uint64_t now_ns (clockid_t clock_id)
+    {
+        struct timespec ts;
+        clock_gettime (clock_id, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    static int write_all (int fd, const void* buf, size_t size)
+    {
+        auto ptr = static_cast<const char*> (buf);
+        while (size > 0) {
+            auto result = ::write (fd, ptr, size);
+            if (result < 0) {
+                if (errno == EINTR)
+                    continue;
+                return -1;
+            }
+            ptr += result;
+            size -= (size_t) result;
+        }
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    static int read_all (int fd, void* buf, size_t size)
+    {
+        auto ptr = static_cast<char*> (buf);
+        while (size > 0) {
+            auto result = ::read (fd, ptr, size);
+            if (result < 0) {
+                if (errno == EINTR)
+                    continue;
+                return -1;
+            }
+            if (result == 0) {
+                errno = EBADMSG; // Truncated dump
+                return -1;
+            }
+            ptr += result;
+            size -= (size_t) result;
+        }
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    FlightRecorder::FlightRecorder (size_t capacity)
+        : mask {1},
+          head {0}
+    {
+        capacity = std::min (std::max(capacity, (size_t)2), (size_t)max_capacity);
+        while (mask+1 < capacity)
+            mask = (mask << 1) | 1;
+        ring.reset (new entry_t[mask+1]);
+        for (size_t i=0; i<=mask; ++i) {
+            auto& entry = ring[i];
+            entry.seq.store (0, std::memory_order_relaxed);
+            entry.time = 0;
+            entry.result = 0;
+            entry.fd = -1;
+            entry.size = 0;
+            entry.errnum = 0;
+            entry.event = event_t::queued;
+            entry.flags = 0;
+            entry.reserved = 0;
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void FlightRecorder::record (event_t event, int fd, uint8_t flags,
+                                 size_t size, int64_t result, int errnum)
+    {
+        auto seq = head.fetch_add (1, std::memory_order_relaxed) + 1;
+        auto& entry = ring[(seq-1) & mask];
+
+        // Mark the entry as being written
+        entry.seq.store (0, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_release);
+
+        entry.time   = now_ns (CLOCK_MONOTONIC);
+        entry.result = result;
+        entry.fd     = fd;
+        entry.size   = size > UINT32_MAX ? UINT32_MAX : (uint32_t) size;
+        entry.errnum = errnum;
+        entry.event  = event;
+        entry.flags  = flags;
+
+        entry.seq.store (seq, std::memory_order_release);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    bool FlightRecorder::read_entry (const entry_t& entry, record_t& rec)
+    {
+        rec.seq = entry.seq.load (std::memory_order_acquire);
+        if (rec.seq == 0)
+            return false;
+
+        rec.time     = entry.time;
+        rec.result   = entry.result;
+        rec.fd       = entry.fd;
+        rec.size     = entry.size;
+        rec.errnum   = entry.errnum;
+        rec.event    = entry.event;
+        rec.flags    = entry.flags;
+        rec.reserved = 0;
+
+        // Skip the entry if it was overwritten while copying
+        std::atomic_thread_fence (std::memory_order_acquire);
+        return entry.seq.load(std::memory_order_relaxed) == rec.seq;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void FlightRecorder::snapshot (std::vector<record_t>& records) const
+    {
+        records.clear ();
+        records.reserve (mask + 1);
+        record_t rec;
+        for (size_t i=0; i<=mask; ++i) {
+            if (read_entry(ring[i], rec))
+                records.emplace_back (rec);
+        }
+        std::sort (records.begin(), records.end(),
+                   [](const record_t& lhs, const record_t& rhs) {
+                       return lhs.seq < rhs.seq;
+                   });
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int FlightRecorder::dump (int fd) const
+    {
+        // Only async-signal-safe calls from here on
+        dump_header_t header;
+        memset (&header, 0, sizeof(header));
+        memcpy (header.magic, dump_magic, sizeof(header.magic));
+        header.version    = dump_version;
+        header.entry_size = sizeof (entry_t);
+        header.capacity   = (uint32_t) (mask + 1);
+        header.recorded   = head.load (std::memory_order_relaxed);
+        header.mono_time  = now_ns (CLOCK_MONOTONIC);
+        header.real_time  = now_ns (CLOCK_REALTIME);
+
+        if (write_all(fd, &header, sizeof(header)))
+            return -1;
+
+        // Entries being written have sequence number 0
+        // and are ignored when the dump is decoded.
+        return write_all (fd, ring.get(), (mask+1) * sizeof(entry_t));
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int FlightRecorder::dump (const std::string& filename) const
+    {
+        int fd = ::open (filename.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+        if (fd < 0)
+            return -1;
+        int result = dump (fd);
+        int errnum = errno;
+        if (::close(fd) && !result) {
+            result = -1;
+            errnum = errno;
+        }
+        errno = errnum;
+        return result;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int FlightRecorder::load (int fd, std::vector<record_t>& records, dump_info_t& info)
+    {
+        dump_header_t header;
+        records.clear ();
+
+        if (read_all(fd, &header, sizeof(header)))
+            return -1;
+        if (memcmp(header.magic, dump_magic, sizeof(header.magic)) ||
+            header.version != dump_version ||
+            header.entry_size != sizeof(record_t) ||
+            header.capacity == 0 ||
+            header.capacity > max_capacity ||
+            (header.capacity & (header.capacity - 1)))
+        {
+            errno = EBADMSG;
+            return -1;
+        }
+
+        std::vector<record_t> entries (header.capacity);
+        if (read_all(fd, entries.data(), entries.size() * sizeof(record_t)))
+            return -1;
+
+        for (auto& rec : entries) {
+            if (rec.seq != 0 && rec.seq <= header.recorded)
+                records.emplace_back (rec);
+        }
+        std::sort (records.begin(), records.end(),
+                   [](const record_t& lhs, const record_t& rhs) {
+                       return lhs.seq < rhs.seq;
+                   });
+
+        info.mono_time = header.mono_time;
+        info.real_time = header.real_time;
+        info.recorded  = header.recorded;
+        info.capacity  = header.capacity;
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int FlightRecorder::load (const std::string& filename,
+                              std::vector<record_t>& records,
+                              dump_info_t& info)
+    {
+        int fd = ::open (filename.c_str(), O_RDONLY|O_CLOEXEC);
+        if (fd < 0)
+            return -1;
+        int result = load (fd, records, info);
+        int errnum = errno;
+        ::close (fd);
+        errno = errnum;
+        return result;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    const char* FlightRecorder::event_name (event_t event)
+    {
+        switch (event) {
+        case event_t::queued:
+            return "queued";
+        case event_t::done:
+            return "done";
+        case event_t::timeout:
+            return "timeout";
+        case event_t::cancel:
+            return "cancel";
+        case event_t::wakeup:
+            return "wakeup";
+        }
+        return "unknown";
+    }
+
+
+}
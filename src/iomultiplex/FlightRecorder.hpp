@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_FLIGHTRECORDER_HPP
+#define IOMULTIPLEX_FLIGHTRECORDER_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+
+
+namespace iomultiplex {
+
+
+    /**
+     * An in-memory flight recorder of recent I/O events.
+     * The recorder is a fixed size ring of compact binary entries.
+     * When the ring is full, the oldest entries are overwritten.
+     * Adding an entry is lock-free and doesn't allocate memory,
+     * so it is cheap enough to always be enabled in production.
+     * <br/>
+     * The ring can be dumped to a file descriptor at any time, also
+     * from a signal handler. A dump is decoded with method
+     * <code>load</code>, see the <code>flight-dump</code> example
+     * program for a small decoding tool.
+     * @see IOHandler_Epoll::flight_recorder
+     */
+    class FlightRecorder {
+    public:
+        /**
+         * Type of recorded event.
+         */
+        enum class event_t : uint8_t {
+            queued  = 1, /**< An I/O operation was queued. <code>result</code> is the timeout. */
+            done    = 2, /**< An I/O operation is finished and its callback called. */
+            timeout = 3, /**< An I/O operation timed out. */
+            cancel  = 4, /**< I/O operations on a file descriptor were cancelled. */
+            wakeup  = 5  /**< The I/O handler woke up with I/O events. <code>result</code> is the number of events, or -1. */
+        };
+
+        static constexpr uint8_t flag_rx   {0x01}; /**< The event concerns a read operation. */
+        static constexpr uint8_t flag_tx   {0x02}; /**< The event concerns a write operation. */
+        static constexpr uint8_t flag_fast {0x04}; /**< Fast cancel. */
+
+        /**
+         * A recorded event.
+         */
+        struct record_t {
+            uint64_t seq;     /**< Sequence number, starts at 1. 0 means an unused entry. */
+            uint64_t time;    /**< CLOCK_MONOTONIC in nanoseconds. */
+            int64_t  result;  /**< Result of the operation, or event specific value. */
+            int32_t  fd;      /**< File descriptor, -1 if not applicable. */
+            uint32_t size;    /**< Requested size of the operation. */
+            int32_t  errnum;  /**< Error number. */
+            event_t  event;   /**< Type of event. */
+            uint8_t  flags;   /**< Event flags, see <code>flag_rx</code>, <code>flag_tx</code>, and <code>flag_fast</code>. */
+            uint16_t reserved;
+        };
+
+        /**
+         * Information about a dump, filled in by method <code>load</code>.
+         */
+        struct dump_info_t {
+            uint64_t mono_time; /**< CLOCK_MONOTONIC in nanoseconds when the dump was made. */
+            uint64_t real_time; /**< CLOCK_REALTIME in nanoseconds when the dump was made. */
+            uint64_t recorded;  /**< Total number of events recorded, including overwritten ones. */
+            uint32_t capacity;  /**< The number of entries in the ring. */
+        };
+
+        /**
+         * Default number of entries in the ring.
+         */
+        static constexpr size_t default_capacity {4096};
+
+        /**
+         * Constructor.
+         * @param capacity The number of entries in the ring.
+         *                 This is rounded up to the nearest
+         *                 power of two.
+         */
+        FlightRecorder (size_t capacity=default_capacity);
+
+        /**
+         * Get the number of entries in the ring.
+         * @return The number of entries.
+         */
+        size_t capacity () const {
+            return mask + 1;
+        }
+
+        /**
+         * Get the total number of events recorded.
+         * This includes events that have been overwritten.
+         * @return The number of recorded events.
+         */
+        uint64_t recorded () const {
+            return head.load (std::memory_order_relaxed);
+        }
+
+        /**
+         * Record an event.
+         * This method is lock-free and may be called from any thread.
+         * @param event The type of event.
+         * @param fd The file descriptor, or -1.
+         * @param flags Event flags.
+         * @param size The requested size of the operation.
+         * @param result The result of the operation.
+         * @param errnum The error number.
+         */
+        void record (event_t event, int fd, uint8_t flags,
+                     size_t size=0, int64_t result=0, int errnum=0);
+
+        /**
+         * Get a copy of the recorded events.
+         * Entries being written while copying are skipped.
+         * @param records Where to store the events,
+         *                sorted from oldest to newest.
+         */
+        void snapshot (std::vector<record_t>& records) const;
+
+        /**
+         * Write the ring in binary form to a file descriptor.
+         * This method only uses async-signal-safe functions,
+         * and may be called from a signal handler, for example
+         * when the application crashes.
+         * @param fd The file descriptor to write to.
+         * @return 0 on success, -1 on error and <code>errno</code>
+         *         is set to an appropriate value.
+         */
+        int dump (int fd) const;
+
+        /**
+         * Write the ring in binary form to a file.
+         * An existing file is truncated.
+         * @param filename The name of the file.
+         * @return 0 on success, -1 on error and <code>errno</code>
+         *         is set to an appropriate value.
+         */
+        int dump (const std::string& filename) const;
+
+        /**
+         * Decode a dump made by method <code>dump</code>.
+         * @param fd The file descriptor to read the dump from.
+         * @param records Where to store the events,
+         *                sorted from oldest to newest.
+         * @param info Where to store information about the dump.
+         * @return 0 on success, -1 on error and <code>errno</code>
+         *         is set to an appropriate value. If the data
+         *         isn't a valid dump, <code>errno</code> is
+         *         set to <code>EBADMSG</code>.
+         */
+        static int load (int fd, std::vector<record_t>& records, dump_info_t& info);
+
+        /**
+         * Decode a dump file made by method <code>dump</code>.
+         * @param filename The name of the file.
+         * @param records Where to store the events,
+         *                sorted from oldest to newest.
+         * @param info Where to store information about the dump.
+         * @return 0 on success, -1 on error and <code>errno</code>
+         *         is set to an appropriate value.
+         */
+        static int load (const std::string& filename,
+                         std::vector<record_t>& records,
+                         dump_info_t& info);
+
+        /**
+         * Get the name of an event type.
+         * @param event The type of event.
+         * @return A string with the name of the event type.
+         */
+        static const char* event_name (event_t event);
+
+
+    private:
+        // A ring entry. 'seq' is 0 while the entry is written.
+        struct entry_t {
+            std::atomic<uint64_t> seq;
+            uint64_t time;
+            int64_t  result;
+            int32_t  fd;
+            uint32_t size;
+            int32_t  errnum;
+            event_t  event;
+            uint8_t  flags;
+            uint16_t reserved;
+        };
+        static_assert (sizeof(entry_t) == sizeof(record_t),
+                       "ring entries must have the same layout as records");
+
+        std::unique_ptr<entry_t[]> ring;
+        size_t mask;
+        std::atomic<uint64_t> head;
+
+        static bool read_entry (const entry_t& entry, record_t& rec);
+    };
+
+
+}
+#endif
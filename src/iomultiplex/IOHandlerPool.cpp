@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/IOHandlerPool.hpp>
+#include <thread>
+#include <cerrno>
+
+
+namespace iomultiplex {
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    IOHandlerPool::IOHandlerPool (unsigned num_handlers,
+                                  const int signal_num,
+                                  const int max_events_hint)
+        : next_handler {0}
+    {
+        if (num_handlers == 0)
+            num_handlers = std::thread::hardware_concurrency ();
+        if (num_handlers == 0)
+            num_handlers = 1;
+
+        handlers.reserve (num_handlers);
+        for (unsigned i=0; i<num_handlers; ++i)
+            handlers.emplace_back (std::make_unique<IOHandler_Epoll>(signal_num, max_events_hint));
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    IOHandlerPool::~IOHandlerPool ()
+    {
+        stop ();
+        join ();
+        std::lock_guard<std::mutex> lock (listeners_mutex);
+        listeners.clear ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int IOHandlerPool::run ()
+    {
+        for (auto& ioh : handlers) {
+            if (ioh->run(true)) {
+                int errnum = errno;
+                stop ();
+                join ();
+                errno = errnum;
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IOHandlerPool::stop ()
+    {
+        for (auto& ioh : handlers)
+            ioh->stop ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IOHandlerPool::join ()
+    {
+        for (auto& ioh : handlers)
+            ioh->join ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    IOHandler_Epoll& IOHandlerPool::next ()
+    {
+        return *handlers[next_handler++ % handlers.size()];
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int IOHandlerPool::accept (SocketConnection& listener,
+                               SocketConnection::accept_cb_t callback)
+    {
+        std::vector<SocketConnection*> sockets;
+        sockets.push_back (&listener);
+
+        std::lock_guard<std::mutex> lock (listeners_mutex);
+        auto num_listeners = listeners.size ();
+
+        // Undo what is done so far, without calling the callback
+        auto rollback = [&](size_t started) {
+            auto errnum = errno;
+            for (size_t i=0; i<started; ++i)
+                sockets[i]->cancel (true, false, true);
+            listeners.resize (num_listeners);
+            errno = errnum;
+        };
+
+        for (auto& ioh : handlers) {
+            if (ioh.get() == &listener.io_handler())
+                continue;
+            auto sock = listener.share_listener (*ioh);
+            if (sock == nullptr) {
+                rollback (0);
+                return -1;
+            }
+            listeners.emplace_back (sock);
+            sockets.push_back (sock.get());
+        }
+
+        for (size_t i=0; i<sockets.size(); ++i) {
+            if (accept_loop(*sockets[i], callback)) {
+                rollback (i);
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int IOHandlerPool::accept_loop (SocketConnection& listener,
+                                    SocketConnection::accept_cb_t cb)
+    {
+        return listener.accept ([this, cb](SocketConnection& srv,
+                                    std::shared_ptr<SocketConnection> conn,
+                                    int errnum)
+            {
+                if (cb)
+                    cb (srv, conn, errnum);
+                if (errnum==0 || errnum==EAGAIN || errnum==ECONNABORTED)
+                    accept_loop (srv, cb);
+            });
+    }
+
+
+}
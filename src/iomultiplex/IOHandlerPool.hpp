@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_IOHANDLERPOOL_HPP
+#define IOMULTIPLEX_IOHANDLERPOOL_HPP
+
+#include <iomultiplex/IOHandler_Epoll.hpp>
+#include <iomultiplex/SocketConnection.hpp>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <signal.h>
+
+
+namespace iomultiplex {
+
+
+    /**
+     * A group of I/O handlers, each running in its own worker thread.
+     * An I/O handler only uses one worker thread, and all callbacks
+     * for a connection are called in the context of that thread.
+     * To use more than one CPU core, connections are instead spread
+     * over several I/O handlers. Each connection is still handled
+     * by one thread only, so no extra locking is needed in the
+     * connection callbacks.
+     * <br/>
+     * A single listening socket can be shared by all the I/O
+     * handlers using method <code>accept</code>.
+     */
+    class IOHandlerPool {
+    public:
+        /**
+         * Constructor.
+         * @param num_handlers The number of I/O handlers in the pool.
+         *                     If 0, the number of available CPU cores is used.
+         * @param signal_num The signal number used internally
+         *                   by the I/O handlers.
+         * @param max_events_hint The maximum number of events that
+         *                        epoll handles at a time in each
+         *                        I/O handler.
+         * @throw std::system_error If an I/O handler can't be created.
+         */
+        IOHandlerPool (unsigned num_handlers=0,
+                       const int signal_num=SIGRTMIN,
+                       const int max_events_hint=32);
+
+        /**
+         * Destructor.
+         * Stops all I/O handlers and waits for the
+         * worker threads to finish.
+         */
+        ~IOHandlerPool ();
+
+        /**
+         * Start a worker thread for each I/O handler.
+         * This method returns when all worker threads are running.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         *         On failure, I/O handlers already started are stopped.
+         */
+        int run ();
+
+        /**
+         * Stop all I/O handlers.
+         * This method doesn't wait for the worker threads to finish.
+         * @see join
+         */
+        void stop ();
+
+        /**
+         * Wait for all worker threads to finish.
+         */
+        void join ();
+
+        /**
+         * Return the number of I/O handlers in the pool.
+         * @return The number of I/O handlers.
+         */
+        size_t size () const {
+            return handlers.size ();
+        }
+
+        /**
+         * Return an I/O handler in the pool.
+         * @param index The index of the I/O handler,
+         *              must be less than <code>size()</code>.
+         * @return A reference to an I/O handler.
+         */
+        IOHandler_Epoll& operator[] (size_t index) {
+            return *handlers[index];
+        }
+
+        /**
+         * Return the next I/O handler in a round-robin fashion.
+         * Use this when creating new connections to spread
+         * them over the I/O handlers in the pool.
+         * This method is thread safe.
+         * @return A reference to an I/O handler.
+         */
+        IOHandler_Epoll& next ();
+
+        /**
+         * Accept incoming connections in all I/O handlers.
+         * The listening socket is shared with the other I/O handlers
+         * in the pool using <code>SocketConnection::share_listener</code>,
+         * so each incoming connection wakes up only one I/O handler.
+         * Accepted connections are handled by the I/O handler that
+         * accepted them.
+         * <br/>
+         * Connections are accepted until the pool is stopped or
+         * an accept operation fails with an error other than
+         * <code>EAGAIN</code> or <code>ECONNABORTED</code>.
+         * @param listener A listening socket managed by one of the
+         *                 I/O handlers in this pool.
+         * @param callback Called for each accepted connection, or
+         *                 when accepting fails. Called in the context
+         *                 of the I/O handler that accepted the connection.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         *         On failure, no connections are accepted, and the
+         *         shared listening sockets created are closed.
+         */
+        int accept (SocketConnection& listener, SocketConnection::accept_cb_t callback);
+
+
+    private:
+        IOHandlerPool (const IOHandlerPool& pool) = delete;
+        IOHandlerPool& operator= (const IOHandlerPool& pool) = delete;
+
+        int accept_loop (SocketConnection& listener, SocketConnection::accept_cb_t cb);
+
+        std::vector<std::unique_ptr<IOHandler_Epoll>> handlers;
+        std::atomic<unsigned> next_handler;
+        std::mutex listeners_mutex;
+        std::vector<std::shared_ptr<SocketConnection>> listeners;
+    };
+
+
+}
+#endif
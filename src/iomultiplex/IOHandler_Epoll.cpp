@@ -19,13 +19,18 @@
 #include <iomultiplex/IOHandler_Epoll.hpp>
 #include <iomultiplex/io_result_t.hpp>
 #include <iomultiplex/Log.hpp>
+#include <iomultiplex/probes.hpp>
 
 #include <sstream>
+#include <algorithm>
 #include <vector>
 #include <exception>
 #include <system_error>
 #include <cstring>
 #include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cxxabi.h>
 #include <signal.h>
 #include <poll.h>
 #include <unistd.h>
@@ -71,8 +76,8 @@
 #ifdef TX_LIST
 #  undef TX_LIST
 #endif
-#define RX_LIST second.first
-#define TX_LIST second.second
+#define RX_LIST second.rx
+#define TX_LIST second.tx
 
 
 
@@ -219,12 +224,37 @@ namespace iomultiplex {
 
         bool dummy_op; // A dummy operation, don't actually try to read or write anything.
         bool is_rx;    // if true, an RX operation. If false, a TX operation.
+        unsigned gen;  // Cancel generation of the file descriptor when queued.
+        struct timespec queued_at; // When the operation was queued, if tracking latency.
     };
 
 
 
 
 
+    //--------------------------------------------------------------------------
+    // Nanoseconds from 'start' to 'end', 0 if 'end' is before 'start'
+    //--------------------------------------------------------------------------
+    static inline uint64_t elapsed_ns (const struct timespec& start, const struct timespec& end)
+    {
+        timespec_less_t less;
+        if (!less(start, end))
+            return 0;
+        auto diff = end - start;
+        return (uint64_t)diff.tv_sec * 1000000000 + (uint64_t)diff.tv_nsec;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Increase a counter only updated by one thread at a time
+    //--------------------------------------------------------------------------
+    static inline void count (std::atomic<uint64_t>& counter, uint64_t n=1)
+    {
+        counter.store (counter.load(std::memory_order_relaxed) + n,
+                       std::memory_order_relaxed);
+    }
+
+
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
     static void ctl_signal_handler (int sig, siginfo_t* si, void* ucontext)
@@ -285,25 +315,28 @@ namespace iomultiplex {
     //--------------------------------------------------------------------------
     int IOHandler_Epoll::initialize_ctl_signal ()
     {
-        // First, Get the original signal mask
-        sigprocmask (SIG_BLOCK, nullptr, &orig_sigmask);
-        // Then, make sure the control signal is unblocked during epoll_pwait
-        memcpy (&epoll_sigmask, &orig_sigmask, sizeof(sigset_t));
-        sigdelset (&epoll_sigmask, ctl_signal);
-
-        // Now block the control signal used for interrupting epoll_pwait().
+        // Block the control signal used for interrupting epoll_pwait(),
+        // and get the original signal mask in the same call.
         sigset_t ctl_sigset;
         sigemptyset (&ctl_sigset);
         sigaddset (&ctl_sigset, ctl_signal);
-        return sigprocmask (SIG_BLOCK, &ctl_sigset, nullptr);
+        if (sigprocmask(SIG_BLOCK, &ctl_sigset, &orig_sigmask))
+            return -1;
+
+        // Make sure the control signal is unblocked during epoll_pwait
+        memcpy (&epoll_sigmask, &orig_sigmask, sizeof(sigset_t));
+        sigdelset (&epoll_sigmask, ctl_signal);
+        return 0;
     }
 
 
     //--------------------------------------------------------------------------
+    // Restore the signal mask of the calling thread. This matters
+    // for run_once(), that is called in the application's threads.
     //--------------------------------------------------------------------------
     void IOHandler_Epoll::restore_ctl_signal ()
     {
-        sigprocmask (SIG_BLOCK, &orig_sigmask, nullptr);
+        sigprocmask (SIG_SETMASK, &orig_sigmask, nullptr);
     }
 
 
@@ -319,7 +352,24 @@ namespace iomultiplex {
           worker_tid {invalid_pid},
           worker_tgid {invalid_pid},
           fd_map_entry_removed {std::make_pair(-1, false)},
-          currently_handled_fd {-1}
+          currently_handled_fd {-1},
+          optimistic {false},
+          lag_threshold {0},
+          stat_loops {0},
+          stat_events {0},
+          stat_callbacks {0},
+          stat_timeouts {0},
+          recorder {nullptr},
+          track_latency {false},
+          wakeup_time {0, 0},
+          loop_start {0, 0},
+          measure_loop {false},
+          draining {false},
+          drained {false},
+          drain_deadline {0, 0},
+          drain_reported {0},
+          drain_cb {nullptr},
+          rate_limiting {false}
     {
         if (ctl_max_events <= 0)
             throw std::system_error (EINVAL, std::system_category(),
@@ -418,48 +468,13 @@ namespace iomultiplex {
         //
         int errnum = 0;
         struct epoll_event events[ctl_max_events];
+        measure_loop = false;
 
         while (!quit) {
-            int timeout = next_timeout ();
-            TRACE_POLL ("start epoll_pwait, timeout value: %d", timeout);
-
-            ops_lock.unlock ();
-            auto num_events = epoll_pwait (ctl_fd,
-                                           events,
-                                           ctl_max_events,
-                                           timeout,
-                                           &epoll_sigmask);
-            ops_lock.lock ();
-
-            TRACE_POLL ("epoll_pwait result: %d", num_events);
-
-            // I/O operations might have been
-            // cancelled while epoll_wait() slept
-            handle_cancelled_ops ();
-
-            if (num_events < 0) {
-                if (errno != EINTR) {
-                    // epoll_pwait() failed !!!
-                    errnum = errno;
-                    quit = true;
-                    TRACE ("IOHandler_Epoll: error polling I/O: %s", strerror(errnum));
-                }else{
-                    ; // epoll_pwait() was interrupted to recalculate the timeout
-                }
-            }
-            else if (num_events > 0) {
-                io_dispatch (events, num_events);
-                // I/O operations might have been
-                // cancelled in io_dispatch()
-                handle_cancelled_ops ();
-            }
-            else if (!timeout_map.empty()) {
-                struct timespec ts;
-                clock_gettime (CLOCK_MONOTONIC, &ts);
-                handle_timeout (ts);
-                // I/O operations might have been
-                // cancelled in handle_timeout()
-                handle_cancelled_ops ();
+            if (run_iteration(ops_lock, events, -1) < 0) {
+                // epoll_pwait() failed !!!
+                errnum = errno;
+                quit = true;
             }
         }
         state = state_t::stopping;
@@ -476,18 +491,360 @@ namespace iomultiplex {
     }
 
 
+    //--------------------------------------------------------------------------
+    // One iteration of the I/O handler loop.
+    // ops_mutex is locked!
+    // Worker context.
+    // Return the number of I/O events and timeouts handled,
+    // or -1 if epoll_pwait() failed and errno is set.
+    //--------------------------------------------------------------------------
+    int IOHandler_Epoll::run_iteration (std::unique_lock<std::mutex>& ops_lock,
+                                        struct epoll_event* events,
+                                        int max_timeout)
+    {
+        // Call the callbacks of operations completed directly when queued
+        handle_completed_ops ();
+        if (quit)
+            return 0;
+        if (draining && check_drain())
+            return 0; // Draining is done, the I/O handler stops
+        if (!throttle_map.empty())
+            release_throttled ();
+
+        if (lag_threshold && measure_loop) {
+            // Report I/O handler loop iterations that took too long
+            report_lag (lag_t::loop, loop_start, -1, false);
+        }
+
+        int timeout = completed_ops.empty() ? next_timeout() : 0;
+        if (max_timeout >= 0 && (timeout < 0 || timeout > max_timeout))
+            timeout = max_timeout;
+        if (draining) {
+            // Wake up at the drain deadline
+            struct timespec now;
+            clock_gettime (CLOCK_MONOTONIC, &now);
+            int drain_timeout = 0;
+            if (timespec_less_t()(now, drain_deadline)) {
+                auto left = drain_deadline - now;
+                drain_timeout = left.tv_sec * 1000 + (int)((left.tv_nsec + 999999L) / 1000000L);
+            }
+            if (timeout < 0 || drain_timeout < timeout)
+                timeout = drain_timeout;
+        }
+        TRACE_POLL ("start epoll_pwait, timeout value: %d", timeout);
+
+        ops_lock.unlock ();
+        auto num_events = epoll_pwait (ctl_fd,
+                                       events,
+                                       ctl_max_events,
+                                       timeout,
+                                       &epoll_sigmask);
+        int errnum = errno; // Callbacks of cancelled operations may change errno
+        ops_lock.lock ();
+        IOM_PROBE1 (epoll_wakeup, num_events);
+        count (stat_loops);
+        if (recorder && num_events != 0) // Timeouts are recorded separately
+            recorder->record (FlightRecorder::event_t::wakeup, -1, 0, 0, num_events);
+        if (track_latency && num_events > 0)
+            clock_gettime (CLOCK_MONOTONIC, &wakeup_time);
+        measure_loop = lag_threshold != 0;
+        if (measure_loop)
+            clock_gettime (CLOCK_MONOTONIC, &loop_start);
+
+        TRACE_POLL ("epoll_pwait result: %d", num_events);
+
+        // I/O operations might have been
+        // cancelled while epoll_wait() slept
+        handle_cancelled_ops ();
+
+        if (num_events < 0) {
+            if (errnum != EINTR) {
+                // epoll_pwait() failed !!!
+                TRACE ("IOHandler_Epoll: error polling I/O: %s", strerror(errnum));
+                errno = errnum;
+                return -1;
+            }
+            // epoll_pwait() was interrupted to recalculate the timeout
+            return 0;
+        }
+
+        auto handled = stat_timeouts.load (std::memory_order_relaxed);
+        if (num_events > 0) {
+            count (stat_events, num_events);
+            io_dispatch (events, num_events);
+            // I/O operations might have been
+            // cancelled in io_dispatch()
+            handle_cancelled_ops ();
+        }
+        if (!timeout_map.empty() && !quit) {
+            // Handle expired timeouts, also those expiring while dispatching events
+            struct timespec ts;
+            clock_gettime (CLOCK_MONOTONIC, &ts);
+            handle_timeout (ts);
+            // I/O operations might have been
+            // cancelled in handle_timeout()
+            handle_cancelled_ops ();
+        }
+
+        handled = stat_timeouts.load(std::memory_order_relaxed) - handled;
+        return num_events + (int)handled;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int IOHandler_Epoll::run_once (int timeout)
+    {
+        std::unique_lock<std::mutex> ops_lock (ops_mutex);
+
+        if (state != state_t::stopped) {
+            // Already running, either by run() or by another call to run_once()
+            errno = EINPROGRESS;
+            return -1;
+        }
+
+        // Run a single iteration in the context of the caller.
+        // The worker thread id is only valid during the call so
+        // that other threads can interrupt epoll_pwait(). Between
+        // calls the I/O handler behaves as if it is stopped.
+        quit = false;
+        state = state_t::running;
+        worker_tgid = getpid ();
+        worker_tid = (pid_t) syscall (SYS_gettid);
+        initialize_ctl_signal ();
+
+        struct epoll_event events[ctl_max_events];
+        measure_loop = false;
+        auto result = run_iteration (ops_lock, events, timeout<0 ? -1 : timeout);
+        int errnum = result<0 ? errno : 0;
+        if (lag_threshold && measure_loop) {
+            // Report an iteration that took too long
+            report_lag (lag_t::loop, loop_start, -1, false);
+        }
+        if (drained) {
+            // Draining is done, clean up as when run() returns
+            state = state_t::stopping;
+            end_running ();
+        }
+
+        restore_ctl_signal ();
+        worker_tgid = invalid_pid;
+        worker_tid = invalid_pid;
+        state = state_t::stopped;
+        errno = errnum;
+        return result;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int IOHandler_Epoll::poll_timeout ()
+    {
+        std::lock_guard<std::mutex> lock (ops_mutex);
+        return completed_ops.empty() ? next_timeout() : 0;
+    }
+
+
     //--------------------------------------------------------------------------
     // Assume ops_mutex is locked !!!
     //--------------------------------------------------------------------------
-    void IOHandler_Epoll::call_ioop_cb (ioop_t& ioop, const ssize_t result, const int errnum)
+    void IOHandler_Epoll::call_ioop_cb (ioop_t& ioop, const ssize_t result, const int errnum, const int fd)
     {
         if (ioop.cb) {
             ioop.result = result;
             ioop.errnum = errnum;
+            invoke_cb (ioop.cb, ioop, fd, ioop.is_rx);
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Assume ops_mutex is locked !!!
+    // The lock is released while the callback is called.
+    //--------------------------------------------------------------------------
+    bool IOHandler_Epoll::invoke_cb (io_callback_t& cb, io_result_t& ior, int fd, bool read)
+    {
+        bool retval;
+        count (stat_callbacks);
+        IOM_PROBE5 (op_done, fd, read, ior.result, ior.errnum, &ior);
+        if (recorder) {
+            recorder->record (FlightRecorder::event_t::done, fd,
+                              read ? FlightRecorder::flag_rx : FlightRecorder::flag_tx,
+                              ior.size, ior.result, ior.errnum);
+        }
+        if (!lag_threshold) {
             ops_mutex.unlock ();
-            ioop.cb (ioop);
+            retval = cb (ior);
             ops_mutex.lock ();
+        }else{
+            struct timespec start;
+            clock_gettime (CLOCK_MONOTONIC, &start);
+            ops_mutex.unlock ();
+            retval = cb (ior);
+            ops_mutex.lock ();
+            report_lag (lag_t::callback, start, fd, read, &cb);
+        }
+        return retval;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Assume ops_mutex is locked !!!
+    // The lock is released while the callback is called.
+    // 'ready' is when the file descriptor was reported ready.
+    //--------------------------------------------------------------------------
+    bool IOHandler_Epoll::invoke_ioop_cb (ioop_t& ioop, int fd, const struct timespec& ready)
+    {
+        if (!track_latency || (ioop.queued_at.tv_sec==0 && ioop.queued_at.tv_nsec==0))
+            return invoke_cb (ioop.cb, ioop, fd, ioop.is_rx);
+
+        // The operation may have been queued by a callback after the wakeup
+        timespec_less_t less;
+        struct timespec start = less(ready, ioop.queued_at) ? ioop.queued_at : ready;
+        auto wait = elapsed_ns (ioop.queued_at, start);
+
+        // The callback may stop tracking the connection, or destroy it
+        conn_latency_t conn_hist;
+        if (!conn_latency.empty()) {
+            auto entry = conn_latency.find (&ioop.conn);
+            if (entry != conn_latency.end())
+                conn_hist = entry->second;
+        }
+
+        auto retval = invoke_cb (ioop.cb, ioop, fd, ioop.is_rx);
+
+        struct timespec now;
+        clock_gettime (CLOCK_MONOTONIC, &now);
+        auto completion = elapsed_ns (start, now);
+        lat_wait.record (wait);
+        lat_completion.record (completion);
+        if (conn_hist.first)
+            conn_hist.first->record (wait);
+        if (conn_hist.second)
+            conn_hist.second->record (completion);
+
+        return retval;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Assume ops_mutex is locked !!!
+    // The lock is released while the lag callback is called.
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::report_lag (lag_t type,
+                                      const struct timespec& start,
+                                      int fd,
+                                      bool read,
+                                      const io_callback_t* cb)
+    {
+        struct timespec now;
+        clock_gettime (CLOCK_MONOTONIC, &now);
+        timespec_less_t less;
+        if (!less(start, now))
+            return;
+
+        auto diff = now - start;
+        uint64_t duration = (uint64_t)diff.tv_sec * 1000000 + diff.tv_nsec / 1000;
+        unsigned threshold = lag_threshold;
+        if (!threshold || duration < threshold || !lag_cb)
+            return;
+
+        lag_info_t info;
+        info.type = type;
+        info.duration = duration>UINT_MAX ? UINT_MAX : (unsigned)duration;
+        info.fd = fd;
+        info.read = read;
+        if (cb && *cb) {
+            int status = -1;
+            const char* name = cb->target_type().name ();
+            char* demangled = abi::__cxa_demangle (name, nullptr, nullptr, &status);
+            info.cb_type = status==0 ? demangled : name;
+            free (demangled);
         }
+
+        auto hook = lag_cb;
+        ops_mutex.unlock ();
+        hook (*this, info);
+        ops_mutex.lock ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::stats (stats_t& stats)
+    {
+        stats.loops     = stat_loops;
+        stats.events    = stat_events;
+        stats.callbacks = stat_callbacks;
+        stats.timeouts  = stat_timeouts;
+
+        std::lock_guard<std::mutex> lock (ops_mutex);
+        stats.fds    = ops_map.size ();
+        stats.rx_ops = 0;
+        stats.tx_ops = 0;
+        for (auto& entry : ops_map) {
+            stats.rx_ops += entry.RX_LIST.size ();
+            stats.tx_ops += entry.TX_LIST.size ();
+        }
+        stats.timers = timeout_map.size ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::flight_recorder (std::shared_ptr<FlightRecorder> fr)
+    {
+        std::lock_guard<std::mutex> lock (ops_mutex);
+        recorder = fr;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    std::shared_ptr<FlightRecorder> IOHandler_Epoll::flight_recorder ()
+    {
+        std::lock_guard<std::mutex> lock (ops_mutex);
+        return recorder;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::latency_tracking (bool enable)
+    {
+        track_latency = enable;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    bool IOHandler_Epoll::latency_tracking () const
+    {
+        return track_latency;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::connection_latency (Connection& conn,
+                                              std::shared_ptr<LatencyHistogram> wait,
+                                              std::shared_ptr<LatencyHistogram> completion)
+    {
+        std::lock_guard<std::mutex> lock (ops_mutex);
+        if (wait || completion)
+            conn_latency[&conn] = std::make_pair (wait, completion);
+        else
+            conn_latency.erase (&conn);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::lag_detector (unsigned threshold_us, lag_cb_t cb)
+    {
+        std::lock_guard<std::mutex> lock (ops_mutex);
+        lag_cb = cb;
+        lag_threshold = cb ? threshold_us : 0;
     }
 
 
@@ -496,21 +853,289 @@ namespace iomultiplex {
     //--------------------------------------------------------------------------
     void IOHandler_Epoll::end_running ()
     {
+        // Operations already completed are reported with their result
+        while (!completed_ops.empty()) {
+            auto ioop = completed_ops.front ();
+            completed_ops.pop_front ();
+            call_ioop_cb (*ioop, ioop->result, ioop->errnum);
+        }
+
         for (auto& entry : ops_map) {
             // Cancel RX operations
             for (auto& ioop : entry.RX_LIST)
-                call_ioop_cb (*ioop, -1, ECANCELED);
+                call_ioop_cb (*ioop, -1, ECANCELED, entry.first);
             entry.RX_LIST.clear ();
 
             // Cancel TX operations
             for (auto& ioop : entry.TX_LIST)
-                call_ioop_cb (*ioop, -1, ECANCELED);
+                call_ioop_cb (*ioop, -1, ECANCELED, entry.first);
             entry.TX_LIST.clear ();
         }
 
-        rx_cancel_map.clear ();
-        tx_cancel_map.clear ();
+        cancel_list.clear ();
         ops_map.clear ();
+
+        draining = false;
+        drained = false;
+        drain_cb = nullptr;
+        throttle_map.clear ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int IOHandler_Epoll::drain (unsigned timeout, drain_cb_t cb)
+    {
+        std::lock_guard<std::mutex> lock (ops_mutex);
+
+        if (state == state_t::stopping) {
+            errno = ECANCELED;
+            return -1;
+        }
+        if (draining || drained) {
+            errno = EALREADY;
+            return -1;
+        }
+        TRACE ("Draining I/O, timeout %u ms", timeout);
+
+        draining = true;
+        drain_cb = cb;
+        drain_reported = (size_t) -1; // Make sure the start is reported
+        clock_gettime (CLOCK_MONOTONIC, &drain_deadline);
+        drain_deadline.tv_sec  += timeout / 1000;
+        drain_deadline.tv_nsec += (timeout % 1000) * 1000000L;
+        if (drain_deadline.tv_nsec >= 1000000000L) {
+            ++drain_deadline.tv_sec;
+            drain_deadline.tv_nsec -= 1000000000L;
+        }
+
+        // Cancel all read operations, new ones are refused while draining
+        for (auto& entry : ops_map) {
+            if (entry.RX_LIST.empty())
+                continue;
+            ++entry.second.rx_gen;
+            if (!entry.second.cancel_pending) {
+                entry.second.cancel_pending = true;
+                cancel_list.push_back (entry.first);
+            }
+        }
+
+        if (state == state_t::stopped) {
+            handle_cancelled_ops ();
+        }else if (!same_context()) {
+            // Interrupt epoll_pwait() to start draining
+            interrupt_epoll ();
+        }
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Report the progress of draining.
+    // ops_mutex is locked!
+    // Worker context.
+    // Return true if draining is done.
+    //--------------------------------------------------------------------------
+    bool IOHandler_Epoll::check_drain ()
+    {
+        size_t tx_ops = 0;
+        for (auto& entry : ops_map)
+            tx_ops += entry.TX_LIST.size ();
+        for (auto& ioop : completed_ops) {
+            if (!ioop->is_rx)
+                ++tx_ops;
+        }
+
+        struct timespec now;
+        clock_gettime (CLOCK_MONOTONIC, &now);
+        drain_info_t info;
+        info.tx_ops = tx_ops;
+        info.timed_out = tx_ops && !timespec_less_t()(now, drain_deadline);
+        info.done = tx_ops == 0 || info.timed_out;
+
+        if (info.done || tx_ops != drain_reported) {
+            drain_reported = tx_ops;
+            if (drain_cb) {
+                auto cb = drain_cb;
+                ops_mutex.unlock ();
+                cb (*this, info);
+                ops_mutex.lock ();
+            }
+        }
+
+        if (info.done) {
+            TRACE ("Draining I/O done, %u write operations left", tx_ops);
+            draining = false;
+            drained = true;
+            quit = true;
+        }
+        return info.done;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int IOHandler_Epoll::rate_limit (std::shared_ptr<RateLimiter> rx_limiter,
+                                     std::shared_ptr<RateLimiter> tx_limiter)
+    {
+        std::lock_guard<std::mutex> lock (ops_mutex);
+        ioh_limiters = std::make_pair (rx_limiter, tx_limiter);
+        rate_limiting = ioh_limiters.first || ioh_limiters.second || !conn_limiters.empty();
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int IOHandler_Epoll::rate_limit (Connection& conn,
+                                     std::shared_ptr<RateLimiter> rx_limiter,
+                                     std::shared_ptr<RateLimiter> tx_limiter)
+    {
+        std::lock_guard<std::mutex> lock (ops_mutex);
+        if (rx_limiter || tx_limiter)
+            conn_limiters[&conn] = std::make_pair (rx_limiter, tx_limiter);
+        else
+            conn_limiters.erase (&conn);
+        rate_limiting = ioh_limiters.first || ioh_limiters.second || !conn_limiters.empty();
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::forget (Connection& conn)
+    {
+        std::lock_guard<std::mutex> lock (ops_mutex);
+        conn_latency.erase (&conn);
+        if (conn_limiters.erase(&conn))
+            rate_limiting = ioh_limiters.first || ioh_limiters.second || !conn_limiters.empty();
+    }
+
+
+    //--------------------------------------------------------------------------
+    // ops_mutex is locked!
+    // Return 0 if the I/O operation may be done, and reduce size to the
+    // number of bytes allowed if partial is true. Otherwise the delay
+    // in nanoseconds.
+    //--------------------------------------------------------------------------
+    uint64_t IOHandler_Epoll::rate_limit_reserve (Connection& conn, bool read, size_t& size, bool data, bool partial)
+    {
+        uint64_t delay = 0;
+
+        auto& limiter = read ? ioh_limiters.first : ioh_limiters.second;
+        if (limiter)
+            delay = limiter->reserve (size, data, partial);
+
+        auto entry = conn_limiters.find (&conn);
+        if (entry != conn_limiters.end()) {
+            auto& conn_limiter = read ? entry->second.first : entry->second.second;
+            if (conn_limiter)
+                delay = std::max (delay, conn_limiter->reserve(size, data, partial));
+        }
+        return delay;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // ops_mutex is locked!
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::rate_limit_consume (Connection& conn, bool read, size_t bytes)
+    {
+        auto& limiter = read ? ioh_limiters.first : ioh_limiters.second;
+        if (limiter)
+            limiter->consume (bytes);
+
+        auto entry = conn_limiters.find (&conn);
+        if (entry != conn_limiters.end()) {
+            auto& conn_limiter = read ? entry->second.first : entry->second.second;
+            if (conn_limiter)
+                conn_limiter->consume (bytes);
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Stop polling a file descriptor in one direction for a while.
+    // The caller updates the epoll events.
+    // ops_mutex is locked!
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::throttle (ops_t& ops, int fd, bool read, uint64_t delay)
+    {
+        TRACE ("Defer %s operations on file descriptor %d for %lu ns",
+               (read?"input":"output"), fd, (unsigned long)delay);
+        (read ? ops.rx_throttled : ops.tx_throttled) = true;
+
+        struct timespec when;
+        clock_gettime (CLOCK_MONOTONIC, &when);
+        when.tv_sec  += (time_t) (delay / 1000000000ULL);
+        when.tv_nsec += (long) (delay % 1000000000ULL);
+        if (when.tv_nsec >= 1000000000L) {
+            ++when.tv_sec;
+            when.tv_nsec -= 1000000000L;
+        }
+        throttle_map.emplace (when, std::make_pair(fd, read));
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Poll deferred file descriptors again when their time is up.
+    // ops_mutex is locked!
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::release_throttled ()
+    {
+        timespec_less_t less;
+        struct timespec now;
+        clock_gettime (CLOCK_MONOTONIC, &now);
+
+        while (!throttle_map.empty() && !less(now, throttle_map.begin()->first)) {
+            int fd = throttle_map.begin()->second.first;
+            bool read = throttle_map.begin()->second.second;
+            throttle_map.erase (throttle_map.begin());
+
+            auto entry = ops_map.find (fd);
+            if (entry == ops_map.end())
+                continue; // No operations left
+            auto current_epoll_events = entry->second.epoll_events ();
+            (read ? entry->second.rx_throttled : entry->second.tx_throttled) = false;
+            update_epoll_events (fd, current_epoll_events, entry->second.epoll_events());
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    // ops_mutex is locked!
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::update_epoll_events (int fd, uint32_t current_events, uint32_t new_events)
+    {
+        if (new_events == current_events)
+            return;
+
+        if (new_events == 0) {
+            // No more TX/RX operations to poll for
+            TRACE_POLL ("epoll_ctl (%s, %d, nullptr)",
+                        epoll_op_to_string(EPOLL_CTL_DEL).c_str(), fd);
+            epoll_ctl (ctl_fd, EPOLL_CTL_DEL, fd, nullptr);
+            return;
+        }
+
+        int op = current_events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        struct epoll_event event;
+        event.data.fd = fd;
+        event.events = new_events;
+#ifdef EPOLLEXCLUSIVE
+        if (op == EPOLL_CTL_ADD) {
+            auto entry = ops_map.find (fd);
+            if (entry != ops_map.end() &&
+                !entry->RX_LIST.empty() &&
+                entry->RX_LIST.front()->conn.exclusive_wakeup())
+            {
+                event.events |= EPOLLEXCLUSIVE;
+            }
+        }
+#endif
+        TRACE_POLL ("epoll_ctl (%s, %d, %s)",
+                    epoll_op_to_string(op).c_str(), fd, events_to_string(event.events).c_str());
+        epoll_ctl (ctl_fd, op, fd, &event);
     }
 
 
@@ -562,6 +1187,22 @@ namespace iomultiplex {
     }
 
 
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::optimistic_io (bool enable)
+    {
+        optimistic = enable;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    bool IOHandler_Epoll::optimistic_io () const
+    {
+        return optimistic;
+    }
+
+
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
     static bool is_fd_a_file (int fd)
@@ -574,7 +1215,7 @@ namespace iomultiplex {
     //--------------------------------------------------------------------------
     // ops_mutex is locked
     //--------------------------------------------------------------------------
-    int IOHandler_Epoll::queue_io_op_sanity_check (const int fd, const bool read)
+    int IOHandler_Epoll::queue_io_op_sanity_check (const int fd)
     {
         if (fd < 0) {
             // We can't queue an I/O operation with an invalid file descriptor
@@ -586,16 +1227,6 @@ namespace iomultiplex {
             errno = ECANCELED;
             return -1;
         }
-        if (read && rx_cancel_map.find(fd)!=rx_cancel_map.end()) {
-            // RX operations are being cancelled
-            errno = ECANCELED;
-            return -1;
-        }
-        if (!read && tx_cancel_map.find(fd)!=tx_cancel_map.end()) {
-            // TX operations are being cancelled
-            errno = ECANCELED;
-            return -1;
-        }
         return 0;
     }
 
@@ -613,41 +1244,74 @@ namespace iomultiplex {
         std::lock_guard<std::mutex> lock (ops_mutex);
 
         int fd = conn.handle ();
-        if (queue_io_op_sanity_check(fd, read))
+        if (queue_io_op_sanity_check(fd))
             return -1;
 
+        if (read && draining) {
+            // No new read operations while draining
+            errno = ESHUTDOWN;
+            return -1;
+        }
+
+        bool exclusive = conn.exclusive_wakeup ();
+        if (exclusive && !read) {
+            // EPOLLEXCLUSIVE can't be combined with EPOLL_CTL_MOD,
+            // so only read operations are allowed
+            errno = EINVAL;
+            return -1;
+        }
+
         TRACE ("Queue a %s%s operation on file desc %d, %u bytes requested",
                (dummy_operation?"dummy ":""), (read?"Rx":"Tx"), fd, size);
 
         std::shared_ptr<ioop_t> ioop (std::make_shared<ioop_t>(
                                               timeout_map, read, conn, buf, size,
                                               cb, timeout, dummy_operation));
+        if (track_latency)
+            clock_gettime (CLOCK_MONOTONIC, &ioop->queued_at);
 
         bool send_signal {false};
         bool new_ops_map_entry {false};
 
+        bool is_same_context = same_context ();
+        if (optimistic && !rate_limiting && !dummy_operation && is_same_context && state==state_t::running) {
+            auto entry = ops_map.find (fd);
+            if (entry == ops_map.end() || (read ? entry->RX_LIST : entry->TX_LIST).empty()) {
+                // Nothing queued in this direction, try the operation right away
+                if (try_io_op(ioop, fd)) {
+                    errno = 0;
+                    return 0;
+                }
+            }
+        }
+
         auto entry = ops_map.find (fd);
         if (entry == ops_map.end()) {
-            entry = ops_map.emplace (fd, std::make_pair(ioop_list_t(),         // Rx list
-                                                        ioop_list_t())).first; // Tx list
+            entry = ops_map.emplace (fd, ops_t()).first;
             new_ops_map_entry = true;
         }
 
         auto& op_list {read ? entry->RX_LIST : entry->TX_LIST};
+        ioop->gen = read ? entry->second.rx_gen : entry->second.tx_gen;
 
-        bool is_same_context = same_context ();
         if (fd!=currently_handled_fd || !is_same_context || state!=state_t::running) {
-            if (op_list.empty()) {
-                auto& other_op_list {read ? entry->TX_LIST : entry->RX_LIST};
+            auto current_epoll_events = entry->second.epoll_events ();
+            auto new_epoll_events = current_epoll_events;
+            if (!(read ? entry->second.rx_throttled : entry->second.tx_throttled))
+                new_epoll_events |= read ? EPOLLIN : EPOLLOUT;
+            if (new_epoll_events != current_epoll_events) {
                 int op;
                 struct epoll_event event;
                 event.data.fd = fd;
-                if (other_op_list.empty()) {
+                event.events = new_epoll_events;
+                if (current_epoll_events == 0) {
                     op = EPOLL_CTL_ADD;
-                    event.events = read ? EPOLLIN : EPOLLOUT;
+#ifdef EPOLLEXCLUSIVE
+                    if (exclusive)
+                        event.events |= EPOLLEXCLUSIVE;
+#endif
                 }else{
                     op = EPOLL_CTL_MOD;
-                    event.events = EPOLLIN | EPOLLOUT;
                 }
                 TRACE_POLL ("epoll_ctl (%s, %d, %s)",
                             epoll_op_to_string(op).c_str(), fd, events_to_string(event.events).c_str());
@@ -679,6 +1343,7 @@ namespace iomultiplex {
             }
         }
         op_list.emplace_back (ioop);
+        report_queued (*ioop, fd);
 
         // Save the positions to make it easier to remove an ioop from our lists
         ioop->ops_map_pos = entry;
@@ -693,6 +1358,78 @@ namespace iomultiplex {
     }
 
 
+    //--------------------------------------------------------------------------
+    // ops_mutex is locked!
+    // Worker context.
+    // Return true if the operation is done and its callback is
+    // scheduled, false if the operation needs to be queued.
+    //--------------------------------------------------------------------------
+    bool IOHandler_Epoll::try_io_op (std::shared_ptr<ioop_t>& ioop, int fd)
+    {
+        int errnum = 0;
+        ssize_t result;
+        if (ioop->is_rx)
+            result = ioop->conn.do_read (ioop->buf, ioop->size, errnum);
+        else
+            result = ioop->conn.do_write (ioop->buf, ioop->size, errnum);
+
+        if (result < 0 && (errnum==EAGAIN || errnum==EWOULDBLOCK))
+            return false;
+
+        TRACE ("Optimistic %s operation on %d: %ld %s",
+               (ioop->is_rx?"input":"output"), fd, result,
+               (result<0?strerror(errnum):""));
+
+        // Already done, it can't time out
+        if (ioop->timeout_map_pos != timeout_map.end()) {
+            timeout_map.erase (ioop->timeout_map_pos);
+            ioop->timeout_map_pos = timeout_map.end ();
+        }
+        ioop->result = result;
+        ioop->errnum = errnum;
+        report_queued (*ioop, fd);
+        completed_ops.emplace_back (ioop);
+        return true;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // ops_mutex is locked!
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::report_queued (ioop_t& ioop, int fd)
+    {
+        IOM_PROBE5 (op_queued, fd, ioop.is_rx, ioop.size, ioop.timeout,
+                    static_cast<io_result_t*>(&ioop));
+        if (recorder) {
+            recorder->record (FlightRecorder::event_t::queued, fd,
+                              ioop.is_rx ? FlightRecorder::flag_rx : FlightRecorder::flag_tx,
+                              ioop.size,
+                              ioop.timeout==(unsigned)-1 ? -1 : (int64_t)ioop.timeout);
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    // ops_mutex is locked!
+    // Worker context.
+    //--------------------------------------------------------------------------
+    void IOHandler_Epoll::handle_completed_ops ()
+    {
+        if (completed_ops.empty())
+            return;
+
+        // Callbacks may complete new operations, they
+        // are handled in the next round of the I/O loop.
+        auto num_ops = completed_ops.size ();
+        while (num_ops-- && !completed_ops.empty()) {
+            auto ioop = completed_ops.front ();
+            completed_ops.pop_front ();
+            if (ioop->cb)
+                invoke_ioop_cb (*ioop, ioop->conn.handle(), ioop->queued_at);
+        }
+    }
+
+
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
     void IOHandler_Epoll::cancel (Connection& conn,
@@ -713,11 +1450,27 @@ namespace iomultiplex {
         if (fd < 0)
             return; // Invalid file handle
 
+        IOM_PROBE4 (cancel, fd, rx, tx, fast);
+
         std::unique_lock<std::mutex> lock (ops_mutex);
 
+        if (recorder) {
+            recorder->record (FlightRecorder::event_t::cancel, fd,
+                              (rx ? FlightRecorder::flag_rx : 0) |
+                              (tx ? FlightRecorder::flag_tx : 0) |
+                              (fast ? FlightRecorder::flag_fast : 0));
+        }
+
         if (state == state_t::stopping)
             return; // I/O handler stopping and cleaning up
 
+        if (fast && !completed_ops.empty()) {
+            // Remove completed operations not yet reported
+            completed_ops.remove_if ([&conn, rx, tx](std::shared_ptr<ioop_t>& ioop)->bool{
+                    return &ioop->conn == &conn && (ioop->is_rx ? rx : tx);
+                });
+        }
+
         auto io_ops = ops_map.find (fd);
         if (io_ops == ops_map.end())
             return; // No I/O operations found for this file descriptor
@@ -730,7 +1483,7 @@ namespace iomultiplex {
         if (tx && tx_op_list.empty())
             tx = false;
 
-        if (!rx && !rx)
+        if (!rx && !tx)
             return; // No operations left to cancel
 
         if (fast) {
@@ -739,14 +1492,11 @@ namespace iomultiplex {
             // without calling any of the operations
             // callback functions.
             //
-            if (rx) {
-                rx_cancel_map.erase (fd);
+            auto current_epoll_events = io_ops->second.epoll_events ();
+            if (rx)
                 rx_op_list.clear ();
-            }
-            if (tx) {
-                tx_cancel_map.erase (fd);
+            if (tx)
                 tx_op_list.clear ();
-            }
 
             // Update the epoll events for this file descriptor
             //
@@ -759,80 +1509,32 @@ namespace iomultiplex {
                 if (fd_map_entry_removed.first == fd)
                     fd_map_entry_removed.second = true; // fd removed from ops_map
             }else{
-                struct epoll_event event;
-                event.data.fd = fd;
-                if (rx)
-                    event.events = EPOLLOUT; // RX operations cancelled, we still have TX operations
-                if (tx)
-                    event.events = EPOLLIN;  // TX operations cancelled, we still have RX operations
-                TRACE_POLL ("epoll_ctl (%s, %d, %s)",
-                            epoll_op_to_string(EPOLL_CTL_MOD).c_str(), fd, events_to_string(event.events).c_str());
-                epoll_ctl (ctl_fd, EPOLL_CTL_MOD, fd, &event); // Modify poll events
+                // Still have operations in the other direction
+                update_epoll_events (fd, current_epoll_events, io_ops->second.epoll_events());
             }
         }else{
             //
             // Cancel all I/O operations in an ordelry fashion,
             // and call the operations callback functions.
-            // Until all operations for this connection are
-            // cancelled, new operations of the same type
-            // that are cancelled are allowed.
+            // Bumping the generation counter marks all currently
+            // queued operations as cancelled, operations queued
+            // after this are not affected.
             //
-            if (rx && rx_cancel_map.emplace(fd).second==false)
-                rx = false;
-            if (tx && tx_cancel_map.emplace(fd).second==false)
-                tx = false;
-
-            if (rx || tx) {
-                if (state == state_t::stopped) {
-                    cancel_while_stopped (conn, rx, tx);
-                }else if (!same_context()) {
-                    // Interrupt epoll_pwait() to handle cancelled I/O operations
-                    interrupt_epoll ();
-                }
-            }
-        }
-    }
-
-
-    //--------------------------------------------------------------------------
-    // ops_mutex is locked!
-    //--------------------------------------------------------------------------
-    void IOHandler_Epoll::cancel_while_stopped (Connection& conn, bool rx, bool tx)
-    {
-        auto fd = conn.handle ();
-        auto entry = ops_map.find (fd);
-
-        if (rx) {
-            // Cancel RX operations
-            for (auto& ioop : entry->RX_LIST)
-                call_ioop_cb (*ioop, -1, ECANCELED);
-            entry->RX_LIST.clear ();
-            rx_cancel_map.erase (fd);
-        }
-        if (tx) {
-            // Cancel TX operations
-            for (auto& ioop : entry->TX_LIST)
-                call_ioop_cb (*ioop, -1, ECANCELED);
-            entry->TX_LIST.clear ();
-            tx_cancel_map.erase (fd);
-        }
-
-        if (entry->RX_LIST.empty() && entry->TX_LIST.empty()) {
-            // All operations for this file descriptor are cancelled
-            TRACE_POLL ("epoll_ctl (%s, %d, nullptr)",
-                        epoll_op_to_string(EPOLL_CTL_DEL).c_str(), fd);
-            epoll_ctl (ctl_fd, EPOLL_CTL_DEL, fd, nullptr);
-            ops_map.erase (entry);
-        }else{
-            struct epoll_event event;
-            event.data.fd = fd;
             if (rx)
-                event.events = EPOLLOUT; // RX operations cancelled, we still have TX operations
+                ++io_ops->second.rx_gen;
             if (tx)
-                event.events = EPOLLIN;  // TX operations cancelled, we still have RX operations
-            TRACE_POLL ("epoll_ctl (%s, %d, %s)",
-                        epoll_op_to_string(EPOLL_CTL_MOD).c_str(), fd, events_to_string(event.events).c_str());
-            epoll_ctl (ctl_fd, EPOLL_CTL_MOD, fd, &event); // Modify poll events
+                ++io_ops->second.tx_gen;
+            if (!io_ops->second.cancel_pending) {
+                io_ops->second.cancel_pending = true;
+                cancel_list.push_back (fd);
+            }
+
+            if (state == state_t::stopped) {
+                handle_cancelled_ops ();
+            }else if (!same_context()) {
+                // Interrupt epoll_pwait() to handle cancelled I/O operations
+                interrupt_epoll ();
+            }
         }
     }
 
@@ -842,20 +1544,32 @@ namespace iomultiplex {
     //--------------------------------------------------------------------------
     int IOHandler_Epoll::next_timeout ()
     {
-        if (timeout_map.empty())
+        if (timeout_map.empty() && throttle_map.empty())
             return -1;
 
         int retval = 0;
-        auto& later = timeout_map.begin()->first;
-
         timespec_less_t less;
+
+        // The earliest of I/O operation timeouts and deferred file descriptors
+        const struct timespec* next;
+        if (timeout_map.empty())
+            next = &throttle_map.begin()->first;
+        else if (throttle_map.empty())
+            next = &timeout_map.begin()->first;
+        else
+            next = less(throttle_map.begin()->first, timeout_map.begin()->first) ?
+                &throttle_map.begin()->first : &timeout_map.begin()->first;
+        auto& later = *next;
+
         struct timespec now;
         struct timespec timeout;
         clock_gettime (CLOCK_MONOTONIC, &now);
         if (less(now, later)) {
             timeout = later - now;
+            // Round up, waking up before the timeout has
+            // expired would only cause another iteration
             retval = timeout.tv_sec * 1000;
-            retval += (int)(timeout.tv_nsec / 1000000L);
+            retval += (int)((timeout.tv_nsec + 999999L) / 1000000L);
         }
 
         return retval;
@@ -869,49 +1583,40 @@ namespace iomultiplex {
     //--------------------------------------------------------------------------
     void IOHandler_Epoll::handle_cancelled_ops ()
     {
-        static constexpr const int rx_op = 0;
-        static constexpr const int tx_op = 1;
-        std::set<int>* cancel_map[2] = {&rx_cancel_map, &tx_cancel_map};
-
-        while (!cancel_map[rx_op]->empty() || !cancel_map[tx_op]->empty()) {
-            for (int op_type=rx_op; op_type<=tx_op; ++op_type) {
-                while (!cancel_map[op_type]->empty()) {
-                    auto fd_entry = cancel_map[op_type]->begin ();
-                    int fd = *fd_entry;
-
-                    auto ops_map_entry = ops_map.find (fd);
-                    if (ops_map_entry != ops_map.end()) {
-                        auto& ioop_list = op_type==rx_op ? ops_map_entry->RX_LIST : ops_map_entry->TX_LIST;
-                        auto& other_ioop_list = op_type==rx_op ? ops_map_entry->TX_LIST : ops_map_entry->RX_LIST;
-                        bool ops_cancelled = false;
-                        for (auto& ioop : ioop_list) {
-                            ops_cancelled = true;
-                            // Callbacks can't add operations for this fd since it's cancelling
-                            call_ioop_cb (*ioop, -1, ECANCELED);
-                        }
-                        // Only modify epoll events if operations were actually removed
-                        if (ops_cancelled) {
-                            ioop_list.clear ();
-                            if (other_ioop_list.empty()) {
-                                // Neither RX nor TX operations left for this file descriptor
-                                TRACE_POLL ("epoll_ctl (%s, %d, nullptr)",
-                                            epoll_op_to_string(EPOLL_CTL_DEL).c_str(), fd);
-                                epoll_ctl (ctl_fd, EPOLL_CTL_DEL, fd, nullptr);
-                                ops_map.erase (ops_map_entry);
-                            }else{
-                                // Only RX or TX operations left for this file desccriptor
-                                struct epoll_event event;
-                                event.data.fd = fd;
-                                event.events = op_type==rx_op ? EPOLLOUT : EPOLLIN;
-                                TRACE_POLL ("epoll_ctl (%s, %d, %s)",
-                                            epoll_op_to_string(EPOLL_CTL_MOD).c_str(),
-                                            fd, events_to_string(event.events).c_str());
-                                epoll_ctl (ctl_fd, EPOLL_CTL_MOD, fd, &event);
-                            }
-                        }
-                    }
-                    cancel_map[op_type]->erase (fd_entry);
+        while (!cancel_list.empty()) {
+            std::vector<int> fds;
+            fds.swap (cancel_list);
+
+            for (auto fd : fds) {
+                auto entry = ops_map.find (fd);
+                if (entry == ops_map.end())
+                    continue;
+                entry->second.cancel_pending = false;
+
+                auto current_epoll_events = entry->second.epoll_events ();
+
+                // Cancelled operations are always first in the queues since
+                // operations queued after a cancel get a newer generation.
+                ioop_list_t cancelled;
+                auto& rx_list = entry->RX_LIST;
+                auto& tx_list = entry->TX_LIST;
+                while (!rx_list.empty() && rx_list.front()->gen != entry->second.rx_gen)
+                    cancelled.splice (cancelled.end(), rx_list, rx_list.begin());
+                while (!tx_list.empty() && tx_list.front()->gen != entry->second.tx_gen)
+                    cancelled.splice (cancelled.end(), tx_list, tx_list.begin());
+
+                // Update epoll events before calling the callbacks,
+                // the callbacks may queue new operations.
+                update_epoll_events (fd, current_epoll_events, entry->second.epoll_events());
+                if (rx_list.empty() && tx_list.empty()) {
+                    // Neither RX nor TX operations left for this file descriptor
+                    ops_map.erase (entry);
+                    if (fd_map_entry_removed.first == fd)
+                        fd_map_entry_removed.second = true; // fd removed from ops_map
                 }
+
+                for (auto& ioop : cancelled)
+                    call_ioop_cb (*ioop, -1, ECANCELED, fd);
             }
         }
     }
@@ -935,6 +1640,8 @@ namespace iomultiplex {
 
             // We have a timeout !
 
+            struct timespec timeout_time = deadline;
+            count (stat_timeouts);
             ioop_t& ioop = entry->second;
             auto callback = ioop.cb;
             io_result_t result (ioop.conn,
@@ -952,11 +1659,7 @@ namespace iomultiplex {
             int fd = ops_map_pos->first;
 
             // Get the current epoll events for this file descriptor
-            uint32_t current_epoll_events = 0;
-            if (!ops_map_pos->RX_LIST.empty())
-                current_epoll_events = EPOLLIN;
-            if (!ops_map_pos->TX_LIST.empty())
-                current_epoll_events |= EPOLLOUT;
+            auto current_epoll_events = ops_map_pos->second.epoll_events ();
 
 #ifdef TRACE_DEBUG_MISC
             auto diff = now - deadline;
@@ -965,18 +1668,28 @@ namespace iomultiplex {
                    diff.tv_sec, diff.tv_nsec);
 #endif
 
+            IOM_PROBE3 (op_timeout, fd, is_rx, static_cast<io_result_t*>(&ioop));
+            if (recorder) {
+                recorder->record (FlightRecorder::event_t::timeout, fd,
+                                  is_rx ? FlightRecorder::flag_rx : FlightRecorder::flag_tx,
+                                  ioop.size);
+            }
+
             // Remove the I/O operation from the queue
             // (its destructor will remove the entry from the timeout mep)
             op_list.erase (op_list_pos);
             if (ops_map_pos->RX_LIST.empty() && ops_map_pos->TX_LIST.empty())
                 ops_map.erase (ops_map_pos);
 
+            if (lag_threshold) {
+                // Report timeouts handled too late
+                report_lag (lag_t::timeout, timeout_time, fd, is_rx);
+            }
+
             currently_handled_fd = fd;
             if (callback) {
                 // Call the callback
-                ops_mutex.unlock ();
-                callback (result);
-                ops_mutex.lock ();
+                invoke_cb (callback, result, fd, is_rx);
             }
             currently_handled_fd = -1;
 
@@ -984,27 +1697,9 @@ namespace iomultiplex {
             //
             uint32_t new_epoll_events = 0;
             auto ops_map_entry = ops_map.find (fd);
-            if (ops_map_entry != ops_map.end()) {
-                if (!ops_map_entry->RX_LIST.empty())
-                    new_epoll_events = EPOLLIN;
-                if (!ops_map_entry->TX_LIST.empty())
-                    new_epoll_events |= EPOLLOUT;
-            }
-            if (new_epoll_events != current_epoll_events) {
-                if (new_epoll_events == 0) {
-                    // No more TX/RX operations
-                    TRACE_POLL ("epoll_ctl (%s, %d, nullptr)",
-                                epoll_op_to_string(EPOLL_CTL_DEL).c_str(), fd);
-                    epoll_ctl (ctl_fd, EPOLL_CTL_DEL, fd, nullptr);
-                }else{
-                    struct epoll_event event;
-                    event.data.fd = fd;
-                    event.events = new_epoll_events;
-                    TRACE_POLL ("epoll_ctl (%s, %d, %s)",
-                                epoll_op_to_string(EPOLL_CTL_MOD).c_str(), fd, events_to_string(event.events).c_str());
-                    epoll_ctl (ctl_fd, EPOLL_CTL_MOD, fd, &event);
-                }
-            }
+            if (ops_map_entry != ops_map.end())
+                new_epoll_events = ops_map_entry->second.epoll_events ();
+            update_epoll_events (fd, current_epoll_events, new_epoll_events);
         }
     }
 
@@ -1028,6 +1723,14 @@ namespace iomultiplex {
             currently_handled_fd = fd;
             uint32_t rxtx = events & (EPOLLOUT|EPOLLIN);
             uint32_t err  = events & (EPOLLERR|EPOLLHUP);
+            if (err == EPOLLERR && handle_error_queue(fd)) {
+                // Not an error, only messages in the socket error queue
+                err = 0;
+                if (rxtx == 0) {
+                    currently_handled_fd = -1;
+                    continue;
+                }
+            }
             if (rxtx == 0) {
                 // Error condition without specific direction
                 handle_event (fd, false, err); // Write
@@ -1043,6 +1746,22 @@ namespace iomultiplex {
     }
 
 
+    //--------------------------------------------------------------------------
+    // ops_mutex is locked!
+    //--------------------------------------------------------------------------
+    bool IOHandler_Epoll::handle_error_queue (int fd)
+    {
+        auto entry = ops_map.find (fd);
+        if (entry == ops_map.end())
+            return false;
+        if (!entry->RX_LIST.empty())
+            return entry->RX_LIST.front()->conn.handle_error_queue ();
+        if (!entry->TX_LIST.empty())
+            return entry->TX_LIST.front()->conn.handle_error_queue ();
+        return false;
+    }
+
+
     //--------------------------------------------------------------------------
     // ops_mutex is locked!
     //--------------------------------------------------------------------------
@@ -1054,21 +1773,41 @@ namespace iomultiplex {
         if (entry == ops_map.end())
             return;
 
-        uint32_t current_epoll_events = 0;
-        if (!entry->RX_LIST.empty())
-            current_epoll_events = EPOLLIN;
-        if (!entry->TX_LIST.empty())
-            current_epoll_events |= EPOLLOUT;
+        auto current_epoll_events = entry->second.epoll_events ();
 
         auto* ioop_list = read ? &(entry->RX_LIST) : &(entry->TX_LIST);
-        auto* cancel_map = read ? &tx_cancel_map : &tx_cancel_map;
         bool done {false};
+        if (!error_flags && (read ? entry->second.rx_throttled : entry->second.tx_throttled))
+            done = true; // Deferred by a rate limiter, the event was already pending
         TRACE ("File descriptor %d have %d %s operation(s)", fd, ioop_list->size(), (read?"input":"output"));
         while (!quit && !done && !ioop_list->empty()) {
             TRACE ("Handle %s operation on %d", (read?"input":"output"), fd);
 
             auto ioop = ioop_list->front ();
 
+            if (ioop->gen != (read ? entry->second.rx_gen : entry->second.tx_gen)) {
+                // Operation is cancelled, leave it to handle_cancelled_ops()
+                break;
+            }
+
+            size_t io_size = ioop->size;
+            if (rate_limiting && !error_flags) {
+                if (entry->second.sock_type == 0) {
+                    socklen_t len = sizeof (entry->second.sock_type);
+                    if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &entry->second.sock_type, &len))
+                        entry->second.sock_type = -1;
+                }
+                // Don't truncate datagrams, or make a read of one too short
+                bool partial = entry->second.sock_type < 0 || entry->second.sock_type == SOCK_STREAM;
+                auto delay = rate_limit_reserve (ioop->conn, read, io_size, !ioop->dummy_op, partial);
+                if (delay) {
+                    // Over the limit, stop polling until there are enough tokens
+                    throttle (entry->second, fd, read, delay);
+                    done = true;
+                    break;
+                }
+            }
+
             if (error_flags) {
                 socklen_t len = sizeof (ioop->errnum);
                 if (getsockopt(fd, SOL_SOCKET, SO_ERROR, (void *)&ioop->errnum, &len))
@@ -1084,9 +1823,9 @@ namespace iomultiplex {
             else{
                 // Read or write using the connection object
                 if (read)
-                    ioop->result = ioop->conn.do_read (ioop->buf, ioop->size, ioop->errnum);
+                    ioop->result = ioop->conn.do_read (ioop->buf, io_size, ioop->errnum);
                 else
-                    ioop->result = ioop->conn.do_write (ioop->buf, ioop->size, ioop->errnum);
+                    ioop->result = ioop->conn.do_write (ioop->buf, io_size, ioop->errnum);
                 if (ioop->result < 0)
                     done = true;
                 TRACE ("Result of %s operation on %d: %ld %s",
@@ -1102,6 +1841,9 @@ namespace iomultiplex {
                 break;
             }
 
+            if (rate_limiting && ioop->result >= 0 && !error_flags)
+                rate_limit_consume (ioop->conn, read, (size_t)ioop->result);
+
             // Remove this operation from the I/O operation queue
             ioop_list->pop_front ();
 
@@ -1111,10 +1853,8 @@ namespace iomultiplex {
             }else{
                 fd_map_entry_removed.first = fd;
                 fd_map_entry_removed.second = false;
-                ops_mutex.unlock ();
-                if (!ioop->cb(*ioop))
+                if (!invoke_ioop_cb(*ioop, fd, wakeup_time))
                     done = true;
-                ops_mutex.lock ();
 
                 // The callback may have invalidated the local variables 'entry' and 'ioop_list'
                 // by calling method 'cancel' and then perhaps 'read'/'write'.
@@ -1130,40 +1870,16 @@ namespace iomultiplex {
                 }
                 fd_map_entry_removed.first = -1; // Invalidate the fd map check
             }
-
-            if (!done && !!ioop_list->empty()) {
-                // Before handling the next operation, check if a callback cancelled operations
-                if (cancel_map->find(fd) != cancel_map->end())
-                    done = true;
-            }
         }
 
         uint32_t new_epoll_events = 0;
 
         if (entry != ops_map.end()) {
-            if (!entry->RX_LIST.empty())
-                new_epoll_events = EPOLLIN;
-            if (!entry->TX_LIST.empty())
-                new_epoll_events |= EPOLLOUT;
-
-            if (new_epoll_events == 0)
+            new_epoll_events = entry->second.epoll_events ();
+            if (entry->RX_LIST.empty() && entry->TX_LIST.empty())
                 ops_map.erase (entry);
         }
-        if (new_epoll_events != current_epoll_events) {
-            if (new_epoll_events == 0) {
-                // No more TX/RX operations
-                TRACE_POLL ("epoll_ctl (%s, %d, nullptr)",
-                            epoll_op_to_string(EPOLL_CTL_DEL).c_str(), fd);
-                epoll_ctl (ctl_fd, EPOLL_CTL_DEL, fd, nullptr);
-            }else{
-                struct epoll_event event;
-                event.data.fd = fd;
-                event.events = new_epoll_events;
-                TRACE_POLL ("epoll_ctl (%s, %d, %s)",
-                            epoll_op_to_string(EPOLL_CTL_MOD).c_str(), fd, events_to_string(event.events).c_str());
-                epoll_ctl (ctl_fd, EPOLL_CTL_MOD, fd, &event);
-            }
-        }
+        update_epoll_events (fd, current_epoll_events, new_epoll_events);
     }
 
 
@@ -1184,7 +1900,9 @@ namespace iomultiplex {
           cb {callback},
           timeout_map {tm},
           dummy_op {dummy},
-          is_rx {read}
+          is_rx {read},
+          gen {0},
+          queued_at {0, 0}
     {
         if (timeout_ms == (unsigned)-1) {
             abs_timeout.tv_sec = 0;
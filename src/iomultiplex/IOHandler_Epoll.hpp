@@ -22,6 +22,8 @@
 #include <iomultiplex/types.hpp>
 #include <iomultiplex/Connection.hpp>
 #include <iomultiplex/iohandler_base.hpp>
+#include <iomultiplex/FlightRecorder.hpp>
+#include <iomultiplex/LatencyHistogram.hpp>
 #include <functional>
 #include <memory>
 #include <atomic>
@@ -31,7 +33,10 @@
 #include <list>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <string>
 #include <ctime>
+#include <cstdint>
 #include <signal.h>
 #include <sys/types.h>
 #include <poll.h>
@@ -46,6 +51,68 @@ namespace iomultiplex {
      */
     class IOHandler_Epoll : public iohandler_base {
     public:
+        /**
+         * The kind of delay reported by the lag detector.
+         */
+        enum class lag_t {
+            callback, /**< An I/O callback took too long to return. */
+            loop,     /**< One iteration of the I/O handler loop took too long. */
+            timeout   /**< A timeout was handled too late. */
+        };
+
+        /**
+         * Information about a detected delay in the I/O handler.
+         */
+        struct lag_info_t {
+            lag_t type;            /**< The kind of delay. */
+            unsigned duration;     /**< Callback duration, loop iteration time,
+                                        or timeout lateness, in microseconds. */
+            int fd;                /**< The file descriptor, or -1 for type <code>loop</code>. */
+            bool read;             /**< <code>true</code> for a read operation,
+                                        <code>false</code> for a write operation. */
+            std::string cb_type;   /**< The type name of the callback, if known. */
+        };
+
+        /**
+         * Callback reporting a delay in the I/O handler.
+         * Called in the context of the I/O handler.
+         * @param ioh The I/O handler.
+         * @param info Information about the delay.
+         */
+        using lag_cb_t = std::function<void (IOHandler_Epoll& ioh, const lag_info_t& info)>;
+
+        /**
+         * Statistics of the I/O handler.
+         */
+        struct stats_t {
+            uint64_t loops;     /**< Number of I/O handler loop iterations. */
+            uint64_t events;    /**< Number of epoll events handled. */
+            uint64_t callbacks; /**< Number of I/O callbacks called. */
+            uint64_t timeouts;  /**< Number of I/O operations that timed out. */
+            size_t fds;         /**< Number of file descriptors with queued operations. */
+            size_t rx_ops;      /**< Number of queued read operations. */
+            size_t tx_ops;      /**< Number of queued write operations. */
+            size_t timers;      /**< Number of queued operations with a timeout. */
+        };
+
+        /**
+         * Progress of draining the I/O handler.
+         */
+        struct drain_info_t {
+            size_t tx_ops;  /**< Number of write operations not yet finished. */
+            bool done;      /**< Draining is finished and the I/O handler stops. */
+            bool timed_out; /**< The deadline passed before all
+                                 write operations were finished. */
+        };
+
+        /**
+         * Callback reporting the progress of draining the I/O handler.
+         * Called in the context of the I/O handler.
+         * @param ioh The I/O handler.
+         * @param info The current progress.
+         */
+        using drain_cb_t = std::function<void (IOHandler_Epoll& ioh, const drain_info_t& info)>;
+
         /**
          * Constructor.
          * @param signal_num A signal number used internally by the
@@ -74,8 +141,206 @@ namespace iomultiplex {
                              bool cancel_rx=true,
                              bool cancel_tx=true,
                              bool fast=false);
+        virtual void forget (Connection& conn);
         virtual bool same_context () const;
         virtual void join ();
+        virtual int run_once (int timeout=-1);
+        virtual int rate_limit (std::shared_ptr<RateLimiter> rx_limiter,
+                                std::shared_ptr<RateLimiter> tx_limiter);
+        virtual int rate_limit (Connection& conn,
+                                std::shared_ptr<RateLimiter> rx_limiter,
+                                std::shared_ptr<RateLimiter> tx_limiter);
+
+        /**
+         * Get the epoll file descriptor used by the I/O handler.
+         * This can be used to nest the I/O handler inside another
+         * event loop. The file descriptor becomes readable when
+         * there are I/O events to handle. When it is readable, or
+         * when the time returned by <code>poll_timeout()</code>
+         * has passed, call <code>poll()</code> or
+         * <code>run_once()</code> to handle the events.
+         * \note Don't read from, or modify, the file descriptor.
+         * @return The epoll file descriptor.
+         * @see poll_timeout
+         */
+        int epoll_fd () const {
+            return ctl_fd;
+        }
+
+        /**
+         * Get the time until the I/O handler needs to handle a timeout.
+         * Use this as the timeout when waiting for the epoll file
+         * descriptor in an external event loop.
+         * @return Time in milliseconds until the next timeout
+         *         expires, 0 if there is work to do immediately,
+         *         or -1 if there are no pending timeouts.
+         * @see epoll_fd
+         */
+        int poll_timeout ();
+
+        /**
+         * Enable or disable optimistic I/O.
+         * When enabled, a read or write operation that is queued from
+         * the context of the I/O handler, on a file descriptor without
+         * any other queued operations in the same direction, is tried
+         * immediately. Only if the file descriptor isn't ready
+         * (<code>EAGAIN</code>) is the operation queued and the file
+         * descriptor registered with epoll.
+         * <br/>The callback of an operation that completes immediately
+         * is still called asynchronously, in the next iteration of the
+         * I/O handler loop, and in the order the operations were queued.
+         * <br/>Default is disabled.
+         * \note If a connection is cancelled with parameter
+         *       <code>fast</code> set to <code>false</code>, operations
+         *       that are already completed are reported with their actual
+         *       result and not as cancelled.
+         * @param enable <code>true</code> to enable optimistic I/O.
+         */
+        void optimistic_io (bool enable);
+
+        /**
+         * Check if optimistic I/O is enabled.
+         * @return <code>true</code> if optimistic I/O is enabled.
+         */
+        bool optimistic_io () const;
+
+        /**
+         * Detect slow callbacks and a lagging I/O handler loop.
+         * When enabled, the I/O handler measures the time spent in each
+         * I/O callback, the time of each iteration of the I/O handler
+         * loop, and how late timeouts are handled. Anything exceeding
+         * the threshold is reported to the lag callback, with the
+         * file descriptor, direction, and type of the callback when
+         * known. This makes it possible to find the callback that
+         * stalls the I/O handler, and not only the symptoms.
+         * <br/>Default is disabled.
+         * @param threshold_us Threshold in microseconds.
+         *                     0 disables the lag detector.
+         * @param lag_cb Called for each delay above the threshold.
+         */
+        void lag_detector (unsigned threshold_us, lag_cb_t lag_cb);
+
+        /**
+         * Get statistics of the I/O handler.
+         * The counters are never reset. This method may
+         * be called from any thread.
+         * @param stats Where to store the statistics.
+         */
+        void stats (stats_t& stats);
+
+        /**
+         * Finish queued write operations and then stop the I/O handler.
+         * Unlike <code>stop()</code>, which cancels all queued operations
+         * immediately, this lets responses already being written reach
+         * the peer before the I/O handler stops:
+         * <ul>
+         * <li>All queued read operations, including accept, are cancelled
+         *     with <code>ECANCELED</code>.</li>
+         * <li>New read operations fail with <code>ESHUTDOWN</code>.</li>
+         * <li>Write operations, also those queued while draining,
+         *     continue until none is left or the deadline passes.</li>
+         * </ul>
+         * Then the I/O handler stops, and any write operations left
+         * are cancelled as by <code>stop()</code>.
+         * The progress callback is called when draining starts, each
+         * time the number of unfinished write operations changes,
+         * and when draining is done.
+         * <br/>If the I/O handler isn't running, draining starts when it is run.
+         * @param timeout Deadline in milliseconds for the write operations.
+         * @param drain_cb Called with the progress of the drain.
+         *                 May be <code>nullptr</code>.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         *         <code>EALREADY</code> if the I/O handler is already draining,
+         *         <code>ECANCELED</code> if it is stopping.
+         */
+        int drain (unsigned timeout, drain_cb_t drain_cb=nullptr);
+
+        /**
+         * Record recent I/O events in a flight recorder.
+         * Queued, finished, timed out, and cancelled I/O operations,
+         * and each wakeup of the I/O handler with I/O events, are recorded with
+         * file descriptor, size, result, error number, and a timestamp.
+         * Keep a reference to the flight recorder to dump it
+         * when the application misbehaves or crashes.
+         * <br/>Default is no flight recorder.
+         * @param fr The flight recorder to use,
+         *           or <code>nullptr</code> to stop recording.
+         */
+        void flight_recorder (std::shared_ptr<FlightRecorder> fr);
+
+        /**
+         * Get the flight recorder used by this I/O handler.
+         * @return The flight recorder, or <code>nullptr</code>
+         *         if none is used.
+         */
+        std::shared_ptr<FlightRecorder> flight_recorder ();
+
+        /**
+         * Measure the latency of I/O operations.
+         * When enabled, two latencies are recorded for each I/O
+         * operation with a callback:
+         * <ul>
+         *   <li>The queue wait, the time from when the operation is
+         *       queued until the file descriptor is reported ready.
+         *       This is time spent waiting for the kernel, or the peer.</li>
+         *   <li>The completion, the time from when the file descriptor
+         *       is reported ready until the callback has returned.
+         *       This is time spent in the I/O handler and the callbacks.</li>
+         * </ul>
+         * Cancelled and timed out operations are not recorded.
+         * <br/>Default is disabled.
+         * @param enable <code>true</code> to measure latencies.
+         * @see wait_latency
+         * @see completion_latency
+         */
+        void latency_tracking (bool enable);
+
+        /**
+         * Check if latency tracking is enabled.
+         * @return <code>true</code> if latency tracking is enabled.
+         */
+        bool latency_tracking () const;
+
+        /**
+         * Measure the latency of I/O operations of a specific connection.
+         * The latencies of the connection are recorded in the given
+         * histograms, in addition to the histograms of the I/O handler.
+         * Latency tracking must be enabled for this to have any effect.
+         * The same histograms may be used by several connections and
+         * I/O handlers. Call this method with <code>nullptr</code>
+         * histograms to stop tracking the connection. Tracking also
+         * stops when the connection is closed.
+         * @param conn The connection to measure.
+         * @param wait Histogram for the queue wait, or <code>nullptr</code>.
+         * @param completion Histogram for the completion, or <code>nullptr</code>.
+         * @see latency_tracking
+         */
+        void connection_latency (Connection& conn,
+                                 std::shared_ptr<LatencyHistogram> wait,
+                                 std::shared_ptr<LatencyHistogram> completion);
+
+        /**
+         * Get the histogram of queue wait latencies.
+         * The histogram may be read, or merged with the histograms
+         * of other I/O handlers, from any thread.
+         * @return The time from queued until ready, for all I/O operations.
+         * @see latency_tracking
+         */
+        const LatencyHistogram& wait_latency () const {
+            return lat_wait;
+        }
+
+        /**
+         * Get the histogram of completion latencies.
+         * The histogram may be read, or merged with the histograms
+         * of other I/O handlers, from any thread.
+         * @return The time from ready until the callback has returned,
+         *         for all I/O operations.
+         * @see latency_tracking
+         */
+        const LatencyHistogram& completion_latency () const {
+            return lat_completion;
+        }
 
 
     protected:
@@ -103,10 +368,24 @@ namespace iomultiplex {
 
         class ioop_t; // A single I/O operation
         using ioop_list_t = std::list<std::shared_ptr<ioop_t>>; // A list of I/O operations
-        using ops_t = std::pair<ioop_list_t,  // read operation queue
-                                ioop_list_t>; // write operation queue
 
         // All I/O operations belonging to a specific file descriptor
+        struct ops_t {
+            ioop_list_t rx;         // read operation queue
+            ioop_list_t tx;         // write operation queue
+            unsigned rx_gen {0};    // Incremented when read operations are cancelled
+            unsigned tx_gen {0};    // Incremented when write operations are cancelled
+            bool cancel_pending {false}; // File descriptor is in cancel_list
+            bool rx_throttled {false};   // Read operations deferred by a rate limiter
+            bool tx_throttled {false};   // Write operations deferred by a rate limiter
+            int sock_type {0};           // Socket type for rate limiting, 0 if unknown, -1 if not a socket
+
+            // The epoll events needed for the queued operations
+            uint32_t epoll_events () const {
+                return (!rx.empty() && !rx_throttled ? (uint32_t)EPOLLIN : 0) |
+                       (!tx.empty() && !tx_throttled ? (uint32_t)EPOLLOUT : 0);
+            }
+        };
         using fd_ops_map_t = std::map<int, ops_t>;
 
         // All I/O operations for each timeout
@@ -134,8 +413,51 @@ namespace iomultiplex {
         std::pair<int, bool> fd_map_entry_removed; // Items in ops_map erased while processing I/O
         int currently_handled_fd; // The current file descriptor being processed
 
-        std::set<int> rx_cancel_map; // RX file descriptors that are being cancelled
-        std::set<int> tx_cancel_map; // TX file descriptors that are being cancelled
+        std::vector<int> cancel_list; // File descriptors with cancelled operations not yet reported
+
+        std::atomic_bool optimistic; // Try I/O operations before queueing them
+        ioop_list_t completed_ops;   // Operations completed when queued, callbacks not yet called
+
+        std::atomic<unsigned> lag_threshold; // Lag detector threshold in microseconds, 0 if disabled
+        lag_cb_t lag_cb;                     // Lag detector callback
+
+        // Statistics, only updated by the worker or with ops_mutex locked
+        std::atomic<uint64_t> stat_loops;
+        std::atomic<uint64_t> stat_events;
+        std::atomic<uint64_t> stat_callbacks;
+        std::atomic<uint64_t> stat_timeouts;
+
+        std::shared_ptr<FlightRecorder> recorder; // Flight recorder, only used with ops_mutex locked
+
+        // Latency tracking
+        using conn_latency_t = std::pair<std::shared_ptr<LatencyHistogram>,  // queue wait
+                                         std::shared_ptr<LatencyHistogram>>; // completion
+        std::atomic_bool track_latency;  // Measure queue wait and completion latency
+        LatencyHistogram lat_wait;       // Time from queued until ready
+        LatencyHistogram lat_completion; // Time from ready until the callback returned
+        std::unordered_map<const Connection*, conn_latency_t> conn_latency; // Per connection histograms
+        struct timespec wakeup_time;     // When epoll_pwait returned, if tracking latency
+
+        struct timespec loop_start; // When the current loop iteration started handling events
+        bool measure_loop;          // Measure the time of the loop iteration
+
+        // Graceful shutdown
+        bool draining;                   // Refuse read operations and stop when writes are done
+        bool drained;                    // Draining finished, the I/O handler is stopping
+        struct timespec drain_deadline;  // When to give up waiting for write operations
+        size_t drain_reported;           // Last number of write operations reported
+        drain_cb_t drain_cb;             // Drain progress callback
+
+        // Rate limiting
+        using limiters_t = std::pair<std::shared_ptr<RateLimiter>,  // read operations
+                                     std::shared_ptr<RateLimiter>>; // write operations
+        using throttle_map_t = std::multimap<struct timespec,
+                                             std::pair<int, bool>, // file descriptor, read
+                                             timespec_less_t>;
+        bool rate_limiting;          // Any rate limiter is set
+        limiters_t ioh_limiters;     // Limiters for all connections
+        std::unordered_map<const Connection*, limiters_t> conn_limiters; // Per connection limiters
+        throttle_map_t throttle_map; // When to poll deferred file descriptors again
 
 
         int initialize_ctl_signal ();
@@ -143,17 +465,34 @@ namespace iomultiplex {
         int start_running (bool start_worker_thread,
                            std::unique_lock<std::mutex>& lock);
         void end_running ();
+        bool check_drain ();
+        uint64_t rate_limit_reserve (Connection& conn, bool read, size_t& size, bool data, bool partial);
+        void rate_limit_consume (Connection& conn, bool read, size_t bytes);
+        void throttle (ops_t& ops, int fd, bool read, uint64_t delay);
+        void release_throttled ();
+        void update_epoll_events (int fd, uint32_t current_events, uint32_t new_events);
+        int run_iteration (std::unique_lock<std::mutex>& ops_lock,
+                           struct epoll_event* events,
+                           int max_timeout);
 
-        int queue_io_op_sanity_check (const int fd, const bool read);
+        int queue_io_op_sanity_check (const int fd);
         int next_timeout ();
-        void call_ioop_cb (ioop_t& ioop, const ssize_t result, const int errnum);
+        void call_ioop_cb (ioop_t& ioop, const ssize_t result, const int errnum, const int fd=-1);
         void handle_timeout (struct timespec& now);
         void io_dispatch (struct epoll_event* events, int num_events);
         void handle_event (int fd, bool read, uint32_t error_flags);
+        bool handle_error_queue (int fd);
         void interrupt_epoll ();
 
+        bool invoke_cb (io_callback_t& cb, io_result_t& ior, int fd, bool read);
+        void report_lag (lag_t type, const struct timespec& start, int fd, bool read,
+                         const io_callback_t* cb=nullptr);
+        bool invoke_ioop_cb (ioop_t& ioop, int fd, const struct timespec& ready);
+
         void handle_cancelled_ops ();
-        void cancel_while_stopped (Connection& conn, bool rx, bool tx);
+        void handle_completed_ops ();
+        bool try_io_op (std::shared_ptr<ioop_t>& ioop, int fd);
+        void report_queued (ioop_t& ioop, int fd);
 
 
         // Control signals used by all instances of this class.
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/IdleTimer.hpp>
+#include <vector>
+#include <tuple>
+#include <cerrno>
+#include <ctime>
+
+
+namespace iomultiplex {
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    IdleTimer::IdleTimer (iohandler_base& ioh, unsigned resolution)
+        : timer (ioh, CLOCK_BOOTTIME),
+          res {resolution ? resolution : default_resolution},
+          coarse_now {now_ms()}
+    {
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    IdleTimer::~IdleTimer ()
+    {
+        timer.close ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    uint64_t IdleTimer::now_ms ()
+    {
+        struct timespec ts;
+        clock_gettime (CLOCK_BOOTTIME, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int IdleTimer::add (Connection& conn,
+                        unsigned idle_timeout,
+                        unsigned deadline,
+                        expire_cb_t callback)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+
+        // Use the real time when adding, the coarse time may be old
+        uint64_t now = now_ms ();
+        coarse_now = now;
+
+        auto& entry = entries[&conn];
+        entry.last_activity = now;
+        entry.idle_timeout = idle_timeout==(unsigned)-1 ? 0 : idle_timeout;
+        entry.deadline = deadline==(unsigned)-1 ? 0 : now + deadline;
+        entry.cb = callback;
+
+        if (entries.size() == 1) {
+            // Start the timer
+            if (timer.set(res, res, [this](){tick();})) {
+                int errnum = errno;
+                entries.erase (&conn);
+                errno = errnum;
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IdleTimer::touch (Connection& conn)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        auto entry = entries.find (&conn);
+        if (entry != entries.end())
+            entry->second.last_activity = coarse_now;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IdleTimer::remove (Connection& conn)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        entries.erase (&conn);
+        if (entries.empty())
+            timer.cancel ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void IdleTimer::clear ()
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        entries.clear ();
+        timer.cancel ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    size_t IdleTimer::size () const
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        return entries.size ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Called in I/O handler context
+    //--------------------------------------------------------------------------
+    void IdleTimer::tick ()
+    {
+        std::vector<std::tuple<Connection*, bool, expire_cb_t>> expired;
+
+        std::unique_lock<std::mutex> lock (mutex);
+        uint64_t now = now_ms ();
+        coarse_now = now;
+
+        for (auto i=entries.begin(); i!=entries.end();) {
+            auto& entry = i->second;
+            bool deadline = entry.deadline && now >= entry.deadline;
+            if (deadline || (entry.idle_timeout && now - entry.last_activity >= entry.idle_timeout)) {
+                expired.emplace_back (i->first, deadline, std::move(entry.cb));
+                i = entries.erase (i);
+            }else{
+                ++i;
+            }
+        }
+        if (entries.empty())
+            timer.cancel ();
+        lock.unlock ();
+
+        for (auto& e : expired) {
+            auto& cb = std::get<2> (e);
+            if (cb)
+                cb (*this, *std::get<0>(e), std::get<1>(e));
+        }
+    }
+
+
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_IDLETIMER_HPP
+#define IOMULTIPLEX_IDLETIMER_HPP
+
+#include <iomultiplex/iohandler_base.hpp>
+#include <iomultiplex/Connection.hpp>
+#include <iomultiplex/TimerConnection.hpp>
+#include <functional>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+
+namespace iomultiplex {
+
+
+    /**
+     * Connection level idle timeouts and deadlines.
+     * Instead of setting a timeout on each I/O operation, a connection
+     * is added to an IdleTimer once, and method <code>touch</code> is
+     * called when there is activity on the connection. Touching a
+     * connection only stores a coarse timestamp, no timers are
+     * re-armed. A single timer fires at a fixed resolution and checks
+     * all connections for expired idle timeouts and deadlines.
+     * <br/>
+     * Because of the coarse clock, a timeout expires between
+     * <code>timeout</code> and <code>timeout + 2 * resolution</code>
+     * milliseconds after the last activity.
+     */
+    class IdleTimer {
+    public:
+        /**
+         * Callback called when a connection has been idle too long,
+         * or has reached its deadline.
+         * The connection is removed from the IdleTimer before the
+         * callback is called. The callback is called in the
+         * context of the I/O handler.
+         * @param it The IdleTimer object.
+         * @param conn The connection that has expired.
+         * @param deadline <code>true</code> if the absolute deadline
+         *                 was reached, <code>false</code> if the
+         *                 connection was idle too long.
+         */
+        using expire_cb_t = std::function<void (IdleTimer& it, Connection& conn, bool deadline)>;
+
+        static constexpr unsigned default_resolution {1000}; /**< Default timer resolution in milliseconds. */
+
+        /**
+         * Constructor.
+         * @param ioh The I/O handler running the timer.
+         * @param resolution The interval, in milliseconds, at
+         *                   which connections are checked.
+         * @throw std::system_error If the timer can't be created.
+         */
+        IdleTimer (iohandler_base& ioh, unsigned resolution=default_resolution);
+
+        /**
+         * Destructor.
+         * Stops the timer. No callbacks are called.
+         */
+        ~IdleTimer ();
+
+        /**
+         * Add, or update, a connection with an idle timeout.
+         * @param conn The connection to monitor.
+         * @param idle_timeout Idle timeout in milliseconds.
+         * @param callback Called when the connection has expired.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int add (Connection& conn, unsigned idle_timeout, expire_cb_t callback) {
+            return add (conn, idle_timeout, (unsigned)-1, callback);
+        }
+
+        /**
+         * Add, or update, a connection with an idle timeout and a deadline.
+         * @param conn The connection to monitor.
+         * @param idle_timeout Idle timeout in milliseconds.
+         *                     If -1, the connection has no idle timeout.
+         * @param deadline Deadline in milliseconds from now. The
+         *                 connection expires at this time regardless
+         *                 of activity. If -1, there is no deadline.
+         * @param callback Called when the connection has expired.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int add (Connection& conn, unsigned idle_timeout, unsigned deadline, expire_cb_t callback);
+
+        /**
+         * Register activity on a connection.
+         * This restarts the idle timeout of the connection.
+         * @param conn A connection previously added.
+         *             If not added, nothing is done.
+         */
+        void touch (Connection& conn);
+
+        /**
+         * Stop monitoring a connection.
+         * @param conn The connection to remove.
+         */
+        void remove (Connection& conn);
+
+        /**
+         * Stop monitoring all connections.
+         */
+        void clear ();
+
+        /**
+         * Return the number of monitored connections.
+         * @return The number of connections.
+         */
+        size_t size () const;
+
+
+    private:
+        IdleTimer () = delete;
+        IdleTimer (const IdleTimer& it) = delete;
+        IdleTimer (IdleTimer&& it) = delete;
+        IdleTimer& operator= (const IdleTimer& it) = delete;
+        IdleTimer& operator= (IdleTimer&& it) = delete;
+
+        struct entry_t {
+            uint64_t last_activity; // Coarse time of last activity
+            uint64_t idle_timeout;  // Idle timeout in milliseconds, 0 if none
+            uint64_t deadline;      // Absolute deadline, 0 if none
+            expire_cb_t cb;
+        };
+
+        static uint64_t now_ms ();
+        void tick ();
+
+        TimerConnection timer;
+        const unsigned res;
+        std::atomic<uint64_t> coarse_now;
+        mutable std::mutex mutex;
+        std::unordered_map<Connection*, entry_t> entries;
+    };
+
+
+}
+#endif
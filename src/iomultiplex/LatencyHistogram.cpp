@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/LatencyHistogram.hpp>
+#include <algorithm>
+#include <cmath>
+
+
+namespace iomultiplex {
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    LatencyHistogram::LatencyHistogram ()
+        : total_count {0},
+          total_sum {0},
+          min_ns {UINT64_MAX},
+          max_ns {0}
+    {
+        for (auto& bucket : buckets)
+            bucket.store (0, std::memory_order_relaxed);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    size_t LatencyHistogram::bucket_index (uint64_t ns)
+    {
+        if (ns < sub_count)
+            return (size_t) ns;
+        if (ns > max_value)
+            ns = max_value;
+
+        // Position of the most significant bit, always >= sub_bits
+        unsigned msb = 63 - __builtin_clzll (ns);
+        unsigned shift = msb - sub_bits;
+        return sub_count + shift * sub_count + ((ns >> shift) - sub_count);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    uint64_t LatencyHistogram::bucket_high (size_t index)
+    {
+        if (index < sub_count)
+            return index;
+        unsigned shift = (unsigned) ((index - sub_count) / sub_count);
+        uint64_t mantissa = sub_count + (index - sub_count) % sub_count;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void LatencyHistogram::store_min (std::atomic<uint64_t>& dst, uint64_t value)
+    {
+        auto cur = dst.load (std::memory_order_relaxed);
+        while (value < cur &&
+               !dst.compare_exchange_weak(cur, value, std::memory_order_relaxed))
+            ;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void LatencyHistogram::store_max (std::atomic<uint64_t>& dst, uint64_t value)
+    {
+        auto cur = dst.load (std::memory_order_relaxed);
+        while (value > cur &&
+               !dst.compare_exchange_weak(cur, value, std::memory_order_relaxed))
+            ;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void LatencyHistogram::record (uint64_t ns)
+    {
+        buckets[bucket_index(ns)].fetch_add (1, std::memory_order_relaxed);
+        total_count.fetch_add (1, std::memory_order_relaxed);
+        total_sum.fetch_add (ns, std::memory_order_relaxed);
+        store_min (min_ns, ns);
+        store_max (max_ns, ns);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void LatencyHistogram::merge (const LatencyHistogram& other)
+    {
+        if (&other == this)
+            return;
+        for (size_t i=0; i<num_buckets; ++i) {
+            auto n = other.buckets[i].load (std::memory_order_relaxed);
+            if (n)
+                buckets[i].fetch_add (n, std::memory_order_relaxed);
+        }
+        total_count.fetch_add (other.total_count.load(std::memory_order_relaxed),
+                               std::memory_order_relaxed);
+        total_sum.fetch_add (other.total_sum.load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+        store_min (min_ns, other.min_ns.load(std::memory_order_relaxed));
+        store_max (max_ns, other.max_ns.load(std::memory_order_relaxed));
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void LatencyHistogram::reset ()
+    {
+        for (auto& bucket : buckets)
+            bucket.store (0, std::memory_order_relaxed);
+        total_count.store (0, std::memory_order_relaxed);
+        total_sum.store (0, std::memory_order_relaxed);
+        min_ns.store (UINT64_MAX, std::memory_order_relaxed);
+        max_ns.store (0, std::memory_order_relaxed);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    uint64_t LatencyHistogram::min () const
+    {
+        auto value = min_ns.load (std::memory_order_relaxed);
+        return value==UINT64_MAX ? 0 : value;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    uint64_t LatencyHistogram::mean () const
+    {
+        auto n = count ();
+        return n ? sum() / n : 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    uint64_t LatencyHistogram::percentile (double percentile) const
+    {
+        // Sum the buckets, the total count may be updated while we're counting
+        uint64_t total = 0;
+        for (auto& bucket : buckets)
+            total += bucket.load (std::memory_order_relaxed);
+        if (total == 0)
+            return 0;
+
+        percentile = std::min (std::max(percentile, 0.0), 100.0);
+        auto wanted = (uint64_t) std::ceil (percentile / 100.0 * (double)total);
+        if (wanted == 0)
+            wanted = 1;
+
+        uint64_t seen = 0;
+        for (size_t i=0; i<num_buckets; ++i) {
+            seen += buckets[i].load (std::memory_order_relaxed);
+            if (seen >= wanted)
+                return std::min (bucket_high(i), max());
+        }
+        return max ();
+    }
+
+
+}
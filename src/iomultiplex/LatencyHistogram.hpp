@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_LATENCYHISTOGRAM_HPP
+#define IOMULTIPLEX_LATENCYHISTOGRAM_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+
+namespace iomultiplex {
+
+
+    /**
+     * A fixed size latency histogram.
+     * Values are recorded in nanoseconds in log-linear buckets,
+     * in the same way as an HDR histogram with a precision of
+     * 32 sub-buckets per power of two. This gives a relative
+     * error of less than 3.2% for any recorded value.
+     * Values larger than <code>max_value</code> are recorded
+     * as <code>max_value</code>.
+     * <br/>
+     * Recording is lock-free and may be done from any thread.
+     * Histograms are merged by adding their buckets, which makes
+     * it cheap to aggregate the histograms of several I/O handlers.
+     */
+    class LatencyHistogram {
+    public:
+        /**
+         * The largest value that can be recorded, about 73 minutes.
+         */
+        static constexpr uint64_t max_value {(UINT64_C(1) << 42) - 1};
+
+        /**
+         * Default constructor.
+         * Creates an empty histogram.
+         */
+        LatencyHistogram ();
+
+        /**
+         * Record a value.
+         * @param ns The value in nanoseconds.
+         */
+        void record (uint64_t ns);
+
+        /**
+         * Add all values recorded in another histogram to this one.
+         * @param other The histogram to merge into this histogram.
+         */
+        void merge (const LatencyHistogram& other);
+
+        /**
+         * Remove all recorded values.
+         */
+        void reset ();
+
+        /**
+         * Get the number of recorded values.
+         * @return The number of recorded values.
+         */
+        uint64_t count () const {
+            return total_count.load (std::memory_order_relaxed);
+        }
+
+        /**
+         * Get the sum of all recorded values.
+         * @return The sum in nanoseconds.
+         */
+        uint64_t sum () const {
+            return total_sum.load (std::memory_order_relaxed);
+        }
+
+        /**
+         * Get the smallest recorded value.
+         * @return The smallest value in nanoseconds,
+         *         or 0 if the histogram is empty.
+         */
+        uint64_t min () const;
+
+        /**
+         * Get the largest recorded value.
+         * @return The largest value in nanoseconds.
+         */
+        uint64_t max () const {
+            return max_ns.load (std::memory_order_relaxed);
+        }
+
+        /**
+         * Get the mean of the recorded values.
+         * @return The mean value in nanoseconds,
+         *         or 0 if the histogram is empty.
+         */
+        uint64_t mean () const;
+
+        /**
+         * Get the value at a percentile.
+         * @param percentile The percentile, 0.0 - 100.0.
+         * @return The highest value equivalent to the value
+         *         at the percentile, in nanoseconds.
+         *         0 if the histogram is empty.
+         */
+        uint64_t percentile (double percentile) const;
+
+
+    private:
+        static constexpr unsigned sub_bits {5};
+        static constexpr unsigned sub_count {1u << sub_bits};
+        static constexpr unsigned max_bits {42};
+        static constexpr size_t num_buckets {sub_count + (max_bits - sub_bits) * sub_count};
+
+        std::atomic<uint64_t> buckets[num_buckets];
+        std::atomic<uint64_t> total_count;
+        std::atomic<uint64_t> total_sum;
+        std::atomic<uint64_t> min_ns;
+        std::atomic<uint64_t> max_ns;
+
+        static size_t bucket_index (uint64_t ns);
+        static uint64_t bucket_high (size_t index);
+        static void store_min (std::atomic<uint64_t>& dst, uint64_t value);
+        static void store_max (std::atomic<uint64_t>& dst, uint64_t value);
+    };
+
+
+}
+#endif
@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/MetricsServer.hpp>
+#ifdef HAVE_OPENSSL
+#include <iomultiplex/TlsAdapter.hpp>
+#endif
+#include <cstdio>
+#include <cerrno>
+#include <sys/socket.h>
+
+
+namespace iomultiplex {
+
+
+    static constexpr size_t max_request_size {8192};
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    MetricsServer::MetricsServer (iohandler_base& io_handler)
+        : ioh {io_handler},
+          running {false}
+    {
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    MetricsServer::~MetricsServer ()
+    {
+        stop ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int MetricsServer::start (const SockAddr& addr, int backlog)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        if (running) {
+            errno = EINPROGRESS;
+            return -1;
+        }
+
+        auto sock = std::make_unique<SocketConnection> (ioh);
+        if (sock->open(addr.family(), SOCK_STREAM, 0, true))
+            return -1;
+        sock->setsockopt (SO_REUSEADDR, 1);
+        if (sock->bind(addr) || sock->listen(backlog))
+            return -1;
+
+        if (sock->accept([this](SocketConnection& /*srv*/,
+                                std::shared_ptr<SocketConnection> conn,
+                                int errnum)
+            {
+                on_accept (conn, errnum);
+            }))
+        {
+            return -1;
+        }
+
+        listener = std::move (sock);
+        running = true;
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::stop ()
+    {
+        std::list<std::shared_ptr<client_t>> client_list;
+        std::lock_guard<std::mutex> lock (mutex);
+        running = false;
+        client_list.swap (clients);
+
+        // Use fast cancel, no callbacks are called after this
+        if (listener) {
+            listener->cancel (true, true, true);
+            listener->close ();
+        }
+        for (auto& client : client_list) {
+            client->sock->cancel (true, true, true);
+            client->sock->close ();
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::on_accept (std::shared_ptr<SocketConnection> sock, int errnum)
+    {
+        std::unique_lock<std::mutex> lock (mutex);
+        if (!running)
+            return; // Stopped
+
+        if (errnum == 0) {
+            auto client = std::make_shared<client_t> ();
+            client->sock = sock;
+            clients.emplace_back (client);
+            lock.unlock ();
+            if (sock->read(client->buf, sizeof(client->buf),
+                           [this, client](io_result_t& ior)->bool{
+                               on_rx (client, ior);
+                               return false;
+                           },
+                           default_timeout))
+            {
+                finish (client);
+            }
+            lock.lock ();
+        }
+
+        if (running && errnum!=ECANCELED) {
+            listener->accept ([this](SocketConnection& /*srv*/,
+                                     std::shared_ptr<SocketConnection> conn,
+                                     int errnum)
+                {
+                    on_accept (conn, errnum);
+                });
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::on_rx (std::shared_ptr<client_t> client, io_result_t& ior)
+    {
+        if (ior.result <= 0) {
+            // Error, timeout, or connection closed
+            finish (client);
+            return;
+        }
+
+        client->request.append (client->buf, ior.result);
+        if (client->request.find("\r\n\r\n") != std::string::npos ||
+            client->request.find("\n\n") != std::string::npos)
+        {
+            respond (client);
+        }
+        else if (client->request.size() >= max_request_size) {
+            finish (client);
+        }
+        else if (client->sock->read(client->buf, sizeof(client->buf),
+                                    [this, client](io_result_t& ior)->bool{
+                                        on_rx (client, ior);
+                                        return false;
+                                    },
+                                    default_timeout))
+        {
+            finish (client);
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::respond (std::shared_ptr<client_t> client)
+    {
+        auto& req = client->request;
+        std::string status;
+        std::string content_type {"text/plain; charset=utf-8"};
+        std::string body;
+
+        auto method_end = req.find (' ');
+        auto path_end = method_end==std::string::npos ? method_end : req.find_first_of (" ?\r\n", method_end+1);
+        if (path_end == std::string::npos) {
+            status = "400 Bad Request";
+        }else{
+            auto method = req.substr (0, method_end);
+            auto path = req.substr (method_end+1, path_end-method_end-1);
+            if (method != "GET") {
+                status = "405 Method Not Allowed";
+            }
+            else if (path != "/metrics" && path != "/") {
+                status = "404 Not Found";
+            }else{
+                status = "200 OK";
+                content_type = "text/plain; version=0.0.4; charset=utf-8";
+                body = scrape ();
+            }
+        }
+        if (body.empty() && status[0] != '2')
+            body = status + "\n";
+
+        client->response = "HTTP/1.1 " + status + "\r\n";
+        client->response += "Content-Type: " + content_type + "\r\n";
+        client->response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        client->response += "Connection: close\r\n\r\n";
+        client->response += body;
+        client->sent = 0;
+
+        io_result_t ior (*client->sock, nullptr, 0, 0, 0, 0);
+        on_tx (client, ior);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::on_tx (std::shared_ptr<client_t> client, io_result_t& ior)
+    {
+        if (ior.result < 0) {
+            finish (client);
+            return;
+        }
+        client->sent += (size_t) ior.result;
+        if (client->sent >= client->response.size()) {
+            // All sent
+            finish (client);
+            return;
+        }
+        if (client->sock->write(client->response.data() + client->sent,
+                                client->response.size() - client->sent,
+                                [this, client](io_result_t& ior)->bool{
+                                    on_tx (client, ior);
+                                    return false;
+                                },
+                                default_timeout))
+        {
+            finish (client);
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::finish (std::shared_ptr<client_t> client)
+    {
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            clients.remove (client);
+        }
+        client->sock->close ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    std::string MetricsServer::label (const std::string& name, const std::string& value)
+    {
+        std::string escaped;
+        for (auto c : value) {
+            switch (c) {
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            default:
+                escaped += c;
+            }
+        }
+        return name + "=\"" + escaped + "\"";
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::emit (families_t& families,
+                              const std::string& metric,
+                              const std::string& help,
+                              metric_t type,
+                              const std::string& labels,
+                              double value)
+    {
+        auto& family = families[metric];
+        if (family.help.empty()) {
+            family.help = help;
+            family.type = type;
+        }
+        char value_str[32];
+        snprintf (value_str, sizeof(value_str), "%.15g", value);
+
+        family.samples += metric;
+        if (!labels.empty())
+            family.samples += "{" + labels + "}";
+        family.samples += " ";
+        family.samples += value_str;
+        family.samples += "\n";
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::collect (families_t& f, IOHandler_Epoll& handler, const std::string& l)
+    {
+        IOHandler_Epoll::stats_t s;
+        handler.stats (s);
+        emit (f, "iomultiplex_loop_iterations_total", "I/O handler loop iterations.",
+              metric_t::counter, l, s.loops);
+        emit (f, "iomultiplex_events_total", "I/O events handled.",
+              metric_t::counter, l, s.events);
+        emit (f, "iomultiplex_callbacks_total", "I/O callbacks called.",
+              metric_t::counter, l, s.callbacks);
+        emit (f, "iomultiplex_timeouts_total", "I/O operations timed out.",
+              metric_t::counter, l, s.timeouts);
+        emit (f, "iomultiplex_fds", "File descriptors with queued I/O operations.",
+              metric_t::gauge, l, s.fds);
+        emit (f, "iomultiplex_queued_ops", "Queued I/O operations.",
+              metric_t::gauge, l + ",direction=\"rx\"", s.rx_ops);
+        emit (f, "iomultiplex_queued_ops", "Queued I/O operations.",
+              metric_t::gauge, l + ",direction=\"tx\"", s.tx_ops);
+        emit (f, "iomultiplex_timers", "Queued I/O operations with a timeout.",
+              metric_t::gauge, l, s.timers);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::add (IOHandler_Epoll& handler, const std::string& name)
+    {
+        auto l = label ("handler", name);
+        std::lock_guard<std::mutex> lock (mutex);
+        collectors.emplace_back (&handler, [&handler, l](families_t& f){
+                collect (f, handler, l);
+            });
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::add (IOHandlerPool& pool, const std::string& name)
+    {
+        std::vector<std::pair<IOHandler_Epoll*, std::string>> handlers;
+        for (size_t i=0; i<pool.size(); ++i)
+            handlers.emplace_back (&pool[i], label("handler", name + "/" + std::to_string(i)));
+
+        std::lock_guard<std::mutex> lock (mutex);
+        collectors.emplace_back (&pool, [handlers](families_t& f){
+                for (auto& h : handlers)
+                    collect (f, *h.first, h.second);
+            });
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::add (BufferPool& pool, const std::string& name)
+    {
+        auto l = label ("pool", name);
+        std::lock_guard<std::mutex> lock (mutex);
+        collectors.emplace_back (&pool, [&pool, l](families_t& f){
+                emit (f, "iomultiplex_buffer_pool_buffers", "Buffers allocated by the buffer pool.",
+                      metric_t::gauge, l, pool.capacity());
+                emit (f, "iomultiplex_buffer_pool_buffers_in_use", "Buffers in use.",
+                      metric_t::gauge, l, pool.in_use());
+                emit (f, "iomultiplex_buffer_pool_buffer_size_bytes", "Size of each buffer in bytes.",
+                      metric_t::gauge, l, pool.buf_size());
+            });
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::add (const std::string& metric,
+                             const std::string& help,
+                             metric_t type,
+                             value_cb_t value_cb,
+                             const std::string& labels,
+                             const void* source)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        collectors.emplace_back (source, [metric, help, type, value_cb, labels](families_t& f){
+                if (value_cb)
+                    emit (f, metric, help, type, labels, value_cb());
+            });
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void MetricsServer::remove (const void* source)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        collectors.remove_if ([source](auto& c){return c.first == source;});
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    std::string MetricsServer::scrape ()
+    {
+        families_t families;
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            for (auto& c : collectors)
+                c.second (families);
+        }
+
+#ifdef HAVE_OPENSSL
+        TlsAdapter::handshake_stats_t tls;
+        TlsAdapter::handshake_stats (tls);
+        emit (families, "iomultiplex_tls_handshakes_started_total", "TLS handshakes started.",
+              metric_t::counter, "", tls.started);
+        emit (families, "iomultiplex_tls_handshakes_total", "TLS handshakes finished.",
+              metric_t::counter, "result=\"success\"", tls.succeeded);
+        emit (families, "iomultiplex_tls_handshakes_total", "TLS handshakes finished.",
+              metric_t::counter, "result=\"failure\"", tls.failed);
+        emit (families, "iomultiplex_tls_handshake_seconds_total", "Total time of finished TLS handshakes.",
+              metric_t::counter, "", tls.total_time / 1000000.0);
+#endif
+
+        std::string text;
+        for (auto& entry : families) {
+            auto& family = entry.second;
+            text += "# HELP " + entry.first + " " + family.help + "\n";
+            text += "# TYPE " + entry.first + (family.type==metric_t::counter ? " counter\n" : " gauge\n");
+            text += family.samples;
+        }
+        return text;
+    }
+
+
+}
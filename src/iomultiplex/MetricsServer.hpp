@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_METRICSSERVER_HPP
+#define IOMULTIPLEX_METRICSSERVER_HPP
+
+#include <iomultiplex/iohandler_base.hpp>
+#include <iomultiplex/IOHandler_Epoll.hpp>
+#include <iomultiplex/IOHandlerPool.hpp>
+#include <iomultiplex/BufferPool.hpp>
+#include <iomultiplex/SocketConnection.hpp>
+#include <iomultiplex/SockAddr.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <mutex>
+
+
+namespace iomultiplex {
+
+
+    /**
+     * A small HTTP server exporting metrics in the Prometheus text format.
+     * The server runs on one of the application's own I/O handlers,
+     * no extra threads are used. Any HTTP <code>GET</code> request
+     * for <code>/metrics</code> (or <code>/</code>) is answered with
+     * the current metrics of all registered sources:
+     * <ul>
+     *   <li>I/O handlers and I/O handler pools: loop iterations, events,
+     *       callbacks, timeouts, queued operations, and pending timers.</li>
+     *   <li>Buffer pools: allocated buffers and buffers in use.</li>
+     *   <li>TLS handshake counts and durations, if the library
+     *       is built with TLS support.</li>
+     *   <li>Application defined metrics.</li>
+     * </ul>
+     * Registered sources are referenced, not copied, and must be
+     * removed before they are destroyed.
+     */
+    class MetricsServer {
+    public:
+        /**
+         * Metric types.
+         */
+        enum class metric_t {
+            counter, /**< A value that only increases. */
+            gauge    /**< A value that can go up and down. */
+        };
+
+        /**
+         * Function returning the current value of a metric.
+         * Called in the context of the I/O handler running the server.
+         */
+        using value_cb_t = std::function<double ()>;
+
+        static constexpr unsigned default_timeout {5000}; /**< Default client timeout in milliseconds. */
+
+        /**
+         * Constructor.
+         * @param ioh The I/O handler running the server.
+         */
+        MetricsServer (iohandler_base& ioh);
+
+        /**
+         * Destructor.
+         * Stops the server.
+         */
+        ~MetricsServer ();
+
+        /**
+         * Start serving metrics.
+         * @param addr The local address to listen on.
+         * @param backlog The maximum number of pending connections.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int start (const SockAddr& addr, int backlog=16);
+
+        /**
+         * Stop serving metrics.
+         * The listening socket and all client connections are closed.
+         * \note Don't call this method while a request is being
+         *       handled in another thread. Call it from the context
+         *       of the I/O handler, or when it isn't running.
+         */
+        void stop ();
+
+        /**
+         * Export statistics of an I/O handler.
+         * @param ioh The I/O handler.
+         * @param name The value of label <code>handler</code> in the exported metrics.
+         */
+        void add (IOHandler_Epoll& ioh, const std::string& name);
+
+        /**
+         * Export statistics of all I/O handlers in a pool.
+         * @param pool The I/O handler pool.
+         * @param name The value of label <code>handler</code> in the exported
+         *             metrics, followed by a slash and the index of the
+         *             I/O handler in the pool.
+         */
+        void add (IOHandlerPool& pool, const std::string& name);
+
+        /**
+         * Export the occupancy of a buffer pool.
+         * @param pool The buffer pool.
+         * @param name The value of label <code>pool</code> in the exported metrics.
+         */
+        void add (BufferPool& pool, const std::string& name);
+
+        /**
+         * Export an application defined metric.
+         * @param metric The metric name.
+         * @param help A description of the metric.
+         * @param type The metric type.
+         * @param value_cb Returns the current value of the metric.
+         * @param labels Labels of the metric, without braces,
+         *               for example <code>queue="input"</code>.
+         * @param source An object identifying the metric when calling
+         *               method <code>remove</code>.
+         */
+        void add (const std::string& metric,
+                  const std::string& help,
+                  metric_t type,
+                  value_cb_t value_cb,
+                  const std::string& labels="",
+                  const void* source=nullptr);
+
+        /**
+         * Stop exporting metrics of a source.
+         * @param source An I/O handler, I/O handler pool, buffer pool,
+         *               or a source given when adding an application
+         *               defined metric.
+         */
+        void remove (const void* source);
+
+        /**
+         * Return the current metrics in the Prometheus text format.
+         * @return Metrics in the Prometheus text format.
+         */
+        std::string scrape ();
+
+
+    private:
+        MetricsServer () = delete;
+        MetricsServer (const MetricsServer& ms) = delete;
+        MetricsServer& operator= (const MetricsServer& ms) = delete;
+
+        struct family_t {
+            std::string help;
+            metric_t type;
+            std::string samples;
+        };
+        using families_t = std::map<std::string, family_t>;
+        using collector_t = std::function<void (families_t& families)>;
+
+        struct client_t {
+            std::shared_ptr<SocketConnection> sock;
+            std::string request;
+            std::string response;
+            size_t sent {0};
+            char buf[1024];
+        };
+
+        static void emit (families_t& families,
+                          const std::string& metric,
+                          const std::string& help,
+                          metric_t type,
+                          const std::string& labels,
+                          double value);
+        static std::string label (const std::string& name, const std::string& value);
+        static void collect (families_t& families, IOHandler_Epoll& handler, const std::string& labels);
+
+        void on_accept (std::shared_ptr<SocketConnection> sock, int errnum);
+        void on_rx (std::shared_ptr<client_t> client, io_result_t& ior);
+        void on_tx (std::shared_ptr<client_t> client, io_result_t& ior);
+        void respond (std::shared_ptr<client_t> client);
+        void finish (std::shared_ptr<client_t> client);
+
+        iohandler_base& ioh;
+        std::unique_ptr<SocketConnection> listener;
+        bool running;
+        std::mutex mutex;
+        std::list<std::pair<const void*, collector_t>> collectors;
+        std::list<std::shared_ptr<client_t>> clients;
+    };
+
+
+}
+#endif
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/NetlinkConnection.hpp>
+#include <iomultiplex/iohandler_base.hpp>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+
+namespace iomultiplex {
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    NetlinkConnection::NetlinkConnection (iohandler_base& io_handler, size_t rx_buffer_size)
+        : SocketConnection (io_handler),
+          rx_buf_size {rx_buffer_size ? rx_buffer_size : default_rx_buffer_size},
+          pid {0},
+          seq {(uint32_t) time(nullptr)}
+    {
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    NetlinkConnection::NetlinkConnection (NetlinkConnection&& rhs)
+        : SocketConnection (std::move(rhs)),
+          rx_buf {std::move(rhs.rx_buf)},
+          rx_buf_size {rhs.rx_buf_size},
+          pid {rhs.pid},
+          seq {rhs.seq}
+    {
+        rhs.pid = 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    NetlinkConnection& NetlinkConnection::operator= (NetlinkConnection&& rhs)
+    {
+        if (this != &rhs) {
+            SocketConnection::operator= (std::move(rhs));
+            rx_buf = std::move (rhs.rx_buf);
+            rx_buf_size = rhs.rx_buf_size;
+            pid = rhs.pid;
+            seq = rhs.seq;
+            rhs.pid = 0;
+        }
+        return *this;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int NetlinkConnection::open (int protocol, int sock_rcvbuf)
+    {
+        if (handle() != -1) {
+            errno = EISCONN;
+            return -1;
+        }
+        if (SocketConnection::open(AF_NETLINK, SOCK_RAW, protocol, true))
+            return -1;
+
+        if (sock_rcvbuf > 0) {
+            // Try to override rmem_max first, it requires CAP_NET_ADMIN
+            if (setsockopt(SO_RCVBUFFORCE, sock_rcvbuf))
+                setsockopt (SO_RCVBUF, sock_rcvbuf);
+        }
+
+        struct sockaddr_nl snl;
+        socklen_t len = sizeof (snl);
+        memset (&snl, 0, sizeof(snl));
+        snl.nl_family = AF_NETLINK;
+        if (::bind(handle(), (struct sockaddr*)&snl, sizeof(snl)) ||
+            getsockname(handle(), (struct sockaddr*)&snl, &len))
+        {
+            auto errnum = errno;
+            close ();
+            errno = errnum;
+            return -1;
+        }
+        pid = snl.nl_pid;
+
+        errno = 0;
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    uint32_t NetlinkConnection::port_id () const
+    {
+        return pid;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int NetlinkConnection::add_membership (unsigned group)
+    {
+        int value = (int) group;
+        return setsockopt (SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &value, sizeof(value));
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int NetlinkConnection::drop_membership (unsigned group)
+    {
+        int value = (int) group;
+        return setsockopt (SOL_NETLINK, NETLINK_DROP_MEMBERSHIP, &value, sizeof(value));
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int64_t NetlinkConnection::send_request (uint16_t type,
+                                             uint16_t flags,
+                                             const void* payload,
+                                             size_t payload_len)
+    {
+        if (!payload)
+            payload_len = 0;
+
+        struct nlmsghdr nlh;
+        memset (&nlh, 0, sizeof(nlh));
+        nlh.nlmsg_len   = NLMSG_LENGTH (payload_len);
+        nlh.nlmsg_type  = type;
+        nlh.nlmsg_flags = NLM_F_REQUEST | flags;
+        nlh.nlmsg_seq   = ++seq;
+        nlh.nlmsg_pid   = pid;
+
+        // Payload padding
+        static const char pad[NLMSG_ALIGNTO] = {0};
+        size_t pad_len = NLMSG_ALIGN(payload_len) - payload_len;
+
+        struct iovec iov[3];
+        iov[0].iov_base = &nlh;
+        iov[0].iov_len  = NLMSG_HDRLEN;
+        iov[1].iov_base = const_cast<void*> (payload);
+        iov[1].iov_len  = payload_len;
+        iov[2].iov_base = const_cast<char*> (pad);
+        iov[2].iov_len  = pad_len;
+
+        struct sockaddr_nl kernel;
+        memset (&kernel, 0, sizeof(kernel));
+        kernel.nl_family = AF_NETLINK;
+
+        struct msghdr mh;
+        memset (&mh, 0, sizeof(mh));
+        mh.msg_name    = &kernel;
+        mh.msg_namelen = sizeof (kernel);
+        mh.msg_iov     = iov;
+        mh.msg_iovlen  = pad_len ? 3 : 2;
+
+        if (sendmsg(handle(), &mh, 0) < 0)
+            return -1;
+        return nlh.nlmsg_seq;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int64_t NetlinkConnection::send_dump_request (uint16_t type,
+                                                  const void* payload,
+                                                  size_t payload_len)
+    {
+        return send_request (type, NLM_F_DUMP, payload, payload_len);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int NetlinkConnection::start_rx (msg_cb_t msg_cb)
+    {
+        if (handle() == -1) {
+            errno = EBADF;
+            return -1;
+        }
+        if (!rx_buf)
+            rx_buf.reset (new char[rx_buf_size]);
+
+        return wait_for_rx ([this, msg_cb](io_result_t& ior)->bool{
+                handle_rx (msg_cb, ior.result<0 ? ior.errnum : 0);
+                return false;
+            });
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    unsigned NetlinkConnection::for_each_message (const void* buf,
+                                                  size_t len,
+                                                  std::function<bool (const struct nlmsghdr* msg)> msg_fn)
+    {
+        unsigned count = 0;
+        int remaining = (int) len;
+        for (auto* nlh = (const struct nlmsghdr*) buf;
+             NLMSG_OK(nlh, remaining);
+             nlh = NLMSG_NEXT(nlh, remaining))
+        {
+            ++count;
+            if (msg_fn && !msg_fn(nlh))
+                break;
+        }
+        return count;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Called in I/O handler context
+    //--------------------------------------------------------------------------
+    void NetlinkConnection::handle_rx (msg_cb_t msg_cb, int errnum)
+    {
+        if (errnum) {
+            if (msg_cb)
+                msg_cb (*this, nullptr, errnum);
+            return;
+        }
+
+        // Read all available datagrams
+        bool keep_going = true;
+        while (keep_going) {
+            ssize_t result = recv (handle(), rx_buf.get(), rx_buf_size, MSG_DONTWAIT);
+            if (result < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                if (errno == EINTR)
+                    continue;
+                errnum = errno;
+                keep_going = msg_cb ? msg_cb(*this, nullptr, errnum) : true;
+                if (errnum != ENOBUFS)
+                    return;
+                continue;
+            }
+            for_each_message (rx_buf.get(), (size_t)result, [this, &msg_cb, &keep_going](const struct nlmsghdr* msg)->bool{
+                    if (msg_cb)
+                        keep_going = msg_cb (*this, msg, 0);
+                    return keep_going;
+                });
+        }
+
+        if (keep_going) {
+            if (wait_for_rx([this, msg_cb](io_result_t& ior)->bool{
+                        handle_rx (msg_cb, ior.result<0 ? ior.errnum : 0);
+                        return false;
+                    }))
+            {
+                if (msg_cb)
+                    msg_cb (*this, nullptr, errno);
+            }
+        }
+    }
+
+
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_NETLINKCONNECTION_HPP
+#define IOMULTIPLEX_NETLINKCONNECTION_HPP
+
+#include <iomultiplex/SocketConnection.hpp>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <linux/netlink.h>
+
+
+namespace iomultiplex {
+
+    // Forward declaration
+    class iohandler_base;
+
+
+    /**
+     * A netlink socket connection.
+     * Receives netlink messages in batches into a large internal
+     * buffer, and calls a callback for each message in the buffer.
+     */
+    class NetlinkConnection : public SocketConnection {
+    public:
+        /**
+         * Callback called for each received netlink message.
+         * It is called in the context of the I/O handler.
+         * @param conn The netlink connection that received the message.
+         * @param msg The netlink message, or <code>nullptr</code>
+         *            if <code>errnum</code> isn't 0. Multipart
+         *            messages are delivered one part at a time and are
+         *            ended by a message of type <code>NLMSG_DONE</code>.
+         *            The message is only valid during the callback.
+         * @param errnum 0 on success, otherwise an error code.
+         *               <code>ENOBUFS</code> means that messages
+         *               were lost because the receive buffer overflowed.
+         * @return <code>true</code> to continue receiving messages,
+         *         <code>false</code> to stop. Errors other than
+         *         <code>ENOBUFS</code> always stop the reception.
+         */
+        using msg_cb_t = std::function<bool (NetlinkConnection& conn,
+                                             const struct nlmsghdr* msg,
+                                             int errnum)>;
+
+        static constexpr size_t default_rx_buffer_size {65536};  /**< Default size of the receive buffer used by <code>start_rx</code>. */
+        static constexpr int    default_sock_rcvbuf {4*1024*1024}; /**< Default socket receive buffer size. */
+
+        /**
+         * Constructor.
+         * @param io_handler The iohandler_base object handling the I/O operations.
+         * @param rx_buffer_size The size of the buffer used by method <code>start_rx</code>.
+         */
+        NetlinkConnection (iohandler_base& io_handler, size_t rx_buffer_size=default_rx_buffer_size);
+
+        /**
+         * Move constructor.
+         * @param rhs The NetlinkConnection object to move.
+         */
+        NetlinkConnection (NetlinkConnection&& rhs);
+
+        /**
+         * Destructor.
+         */
+        virtual ~NetlinkConnection () = default;
+
+        /**
+         * Move operator.
+         * @param rhs The NetlinkConnection object to move.
+         * @return A reference to this object.
+         */
+        NetlinkConnection& operator= (NetlinkConnection&& rhs);
+
+        /**
+         * Open and bind a netlink socket.
+         * @param protocol The netlink protocol, like <code>NETLINK_ROUTE</code>.
+         * @param sock_rcvbuf The socket receive buffer size. If the
+         *                    process has <code>CAP_NET_ADMIN</code>, the
+         *                    system limit <code>rmem_max</code> is ignored.
+         *                    If 0, the system default is used.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        int open (int protocol=NETLINK_ROUTE, int sock_rcvbuf=default_sock_rcvbuf);
+
+        /**
+         * Return the netlink port id assigned to the socket.
+         * @return The port id, or 0 if not open.
+         */
+        uint32_t port_id () const;
+
+        /**
+         * Subscribe to a multicast group.
+         * @param group The multicast group, like <code>RTNLGRP_LINK</code>
+         *              or <code>RTNLGRP_IPV4_ROUTE</code>.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        int add_membership (unsigned group);
+
+        /**
+         * Unsubscribe from a multicast group.
+         * @param group The multicast group.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        int drop_membership (unsigned group);
+
+        /**
+         * Send a request to the kernel.
+         * @param type The message type, like <code>RTM_GETROUTE</code>.
+         * @param flags Message flags, <code>NLM_F_REQUEST</code>
+         *              is always added.
+         * @param payload The message payload, may be <code>nullptr</code>.
+         * @param payload_len The size of the payload.
+         * @return The sequence number of the request,
+         *         or -1 on error and <code>errno</code> is set.
+         */
+        int64_t send_request (uint16_t type,
+                              uint16_t flags,
+                              const void* payload,
+                              size_t payload_len);
+
+        /**
+         * Send a dump request to the kernel.
+         * The reply is a multipart message ended by
+         * a message of type <code>NLMSG_DONE</code>.
+         * @param type The message type, like <code>RTM_GETROUTE</code>.
+         * @param payload The message payload, normally a family
+         *                specific header like <code>struct rtmsg</code>.
+         * @param payload_len The size of the payload.
+         * @return The sequence number of the request,
+         *         or -1 on error and <code>errno</code> is set.
+         */
+        int64_t send_dump_request (uint16_t type,
+                                   const void* payload,
+                                   size_t payload_len);
+
+        /**
+         * Start receiving netlink messages.
+         * All pending datagrams are read in one go each time the
+         * socket becomes readable, and the callback is called for
+         * each netlink message in each datagram.
+         * @param msg_cb The callback called for each message.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        int start_rx (msg_cb_t msg_cb);
+
+        /**
+         * Iterate the netlink messages in a buffer.
+         * @param buf A buffer with netlink messages.
+         * @param len The number of bytes in the buffer.
+         * @param msg_fn Called for each message in the buffer.
+         *               Return <code>false</code> to stop iterating.
+         * @return The number of messages iterated.
+         */
+        static unsigned for_each_message (const void* buf,
+                                          size_t len,
+                                          std::function<bool (const struct nlmsghdr* msg)> msg_fn);
+
+
+    private:
+        void handle_rx (msg_cb_t msg_cb, int errnum);
+
+        std::unique_ptr<char[]> rx_buf;
+        size_t rx_buf_size;
+        uint32_t pid;
+        uint32_t seq;
+    };
+
+
+}
+#endif
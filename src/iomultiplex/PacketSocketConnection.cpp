@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/PacketSocketConnection.hpp>
+#include <iomultiplex/iohandler_base.hpp>
+#include <iomultiplex/Log.hpp>
+#include <cstring>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+
+
+namespace iomultiplex {
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    PacketSocketConnection::PacketSocketConnection (iohandler_base& io_handler)
+        : SocketConnection (io_handler),
+          ring {nullptr},
+          ring_size {0},
+          blk_size {0},
+          blk_count {0},
+          cur_blk {0}
+    {
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    PacketSocketConnection::PacketSocketConnection (PacketSocketConnection&& rhs)
+        : SocketConnection (std::move(rhs)),
+          ring {rhs.ring},
+          ring_size {rhs.ring_size},
+          blk_size {rhs.blk_size},
+          blk_count {rhs.blk_count},
+          cur_blk {rhs.cur_blk}
+    {
+        rhs.ring = nullptr;
+        rhs.ring_size = 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    PacketSocketConnection::~PacketSocketConnection ()
+    {
+        close ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    PacketSocketConnection& PacketSocketConnection::operator= (PacketSocketConnection&& rhs)
+    {
+        if (this != &rhs) {
+            close ();
+            SocketConnection::operator= (std::move(rhs));
+            ring      = rhs.ring;
+            ring_size = rhs.ring_size;
+            blk_size  = rhs.blk_size;
+            blk_count = rhs.blk_count;
+            cur_blk   = rhs.cur_blk;
+            rhs.ring = nullptr;
+            rhs.ring_size = 0;
+        }
+        return *this;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int PacketSocketConnection::open (const std::string& ifname,
+                                      int protocol,
+                                      unsigned block_size,
+                                      unsigned block_count,
+                                      unsigned block_timeout,
+                                      unsigned frame_size,
+                                      bool populate)
+    {
+        if (handle() != -1) {
+            errno = EISCONN;
+            return -1;
+        }
+        if (!block_size || !block_count || !frame_size || frame_size > block_size) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        unsigned ifindex = 0;
+        if (!ifname.empty()) {
+            ifindex = if_nametoindex (ifname.c_str());
+            if (!ifindex)
+                return -1;
+        }
+
+        if (SocketConnection::open(AF_PACKET, SOCK_RAW, htons(protocol), true))
+            return -1;
+
+        int version = TPACKET_V3;
+        struct tpacket_req3 req;
+        memset (&req, 0, sizeof(req));
+        req.tp_block_size = block_size;
+        req.tp_block_nr = block_count;
+        req.tp_frame_size = frame_size;
+        req.tp_frame_nr = (block_size / frame_size) * block_count;
+        req.tp_retire_blk_tov = block_timeout;
+        req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+
+        if (setsockopt(SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) ||
+            setsockopt(SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)))
+        {
+            auto errnum = errno;
+            SocketConnection::close ();
+            errno = errnum;
+            return -1;
+        }
+
+        size_t size = (size_t)block_size * block_count;
+        int flags = MAP_SHARED | (populate ? MAP_POPULATE : 0);
+        void* addr = mmap (nullptr, size, PROT_READ|PROT_WRITE, flags, handle(), 0);
+        if (addr == MAP_FAILED) {
+            auto errnum = errno;
+            SocketConnection::close ();
+            errno = errnum;
+            return -1;
+        }
+        ring = (uint8_t*) addr;
+        ring_size = size;
+        blk_size = block_size;
+        blk_count = block_count;
+        cur_blk = 0;
+
+        struct sockaddr_ll sll;
+        memset (&sll, 0, sizeof(sll));
+        sll.sll_family = AF_PACKET;
+        sll.sll_protocol = htons (protocol);
+        sll.sll_ifindex = (int) ifindex;
+        if (::bind(handle(), (struct sockaddr*)&sll, sizeof(sll))) {
+            auto errnum = errno;
+            close ();
+            errno = errnum;
+            return -1;
+        }
+
+        errno = 0;
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void PacketSocketConnection::close ()
+    {
+        SocketConnection::close ();
+        if (ring) {
+            munmap (ring, ring_size);
+            ring = nullptr;
+            ring_size = 0;
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int PacketSocketConnection::fanout (unsigned group_id, int mode, int flags)
+    {
+        if (group_id > 0xffff) {
+            errno = EINVAL;
+            return -1;
+        }
+        int value = (int) group_id | ((mode | flags) << 16);
+        return setsockopt (SOL_PACKET, PACKET_FANOUT, &value, sizeof(value));
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int PacketSocketConnection::start_rx (block_cb_t block_cb)
+    {
+        if (!ring) {
+            errno = EBADF;
+            return -1;
+        }
+        return wait_for_rx ([this, block_cb](io_result_t& ior)->bool{
+                handle_rx (block_cb, ior.result<0 ? ior.errnum : 0);
+                return false;
+            });
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int PacketSocketConnection::stats (struct tpacket_stats_v3& stats)
+    {
+        socklen_t len = sizeof (stats);
+        return getsockopt (SOL_PACKET, PACKET_STATISTICS, &stats, &len);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    unsigned PacketSocketConnection::for_each_packet (const struct tpacket_block_desc& block,
+                                                      packet_cb_t packet_cb)
+    {
+        auto num_pkts = block.hdr.bh1.num_pkts;
+        if (!packet_cb)
+            return num_pkts;
+
+        auto* hdr = (const struct tpacket3_hdr*)
+            ((const uint8_t*)&block + block.hdr.bh1.offset_to_first_pkt);
+        for (unsigned i=0; i<num_pkts; ++i) {
+            packet_cb (*hdr, ((const uint8_t*)hdr) + hdr->tp_mac);
+            hdr = (const struct tpacket3_hdr*) (((const uint8_t*)hdr) + hdr->tp_next_offset);
+        }
+        return num_pkts;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Called in I/O handler context
+    //--------------------------------------------------------------------------
+    void PacketSocketConnection::handle_rx (block_cb_t block_cb, int errnum)
+    {
+        if (errnum || !ring) {
+            if (block_cb)
+                block_cb (*this, nullptr, errnum ? errnum : EBADF);
+            return;
+        }
+
+        // Hand over all blocks owned by user space
+        while (true) {
+            auto* block = (struct tpacket_block_desc*) (ring + (size_t)cur_blk * blk_size);
+            if ((__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0)
+                break;
+
+            bool keep_going = block_cb ? block_cb(*this, block, 0) : true;
+
+            // Return the block to the kernel
+            __atomic_store_n (&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+            cur_blk = (cur_blk + 1) % blk_count;
+
+            if (!keep_going)
+                return;
+        }
+
+        if (wait_for_rx([this, block_cb](io_result_t& ior)->bool{
+                    handle_rx (block_cb, ior.result<0 ? ior.errnum : 0);
+                    return false;
+                }))
+        {
+            if (block_cb)
+                block_cb (*this, nullptr, errno);
+        }
+    }
+
+
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_PACKETSOCKETCONNECTION_HPP
+#define IOMULTIPLEX_PACKETSOCKETCONNECTION_HPP
+
+#include <iomultiplex/SocketConnection.hpp>
+#include <functional>
+#include <string>
+#include <cstdint>
+#include <linux/if_packet.h>
+
+
+namespace iomultiplex {
+
+    // Forward declaration
+    class iohandler_base;
+
+
+    /**
+     * A raw packet socket (<code>AF_PACKET</code>) using a memory mapped
+     * receive ring in TPACKET_V3 block mode.
+     * The kernel fills blocks of frames in a ring shared with the
+     * application, and a whole block is handed to the application
+     * at a time. This way no system call is needed per packet.
+     * \note Opening a packet socket requires the
+     *       <code>CAP_NET_RAW</code> capability.
+     */
+    class PacketSocketConnection : public SocketConnection {
+    public:
+        /**
+         * Callback called for each block of frames received.
+         * It is called in the context of the I/O handler.
+         * @param conn The packet socket that received the block.
+         * @param block The block of frames, or <code>nullptr</code>
+         *              if <code>errnum</code> isn't 0.
+         *              Use method <code>for_each_packet</code>
+         *              to iterate the frames in the block.
+         *              The block is returned to the kernel
+         *              when the callback returns.
+         * @param errnum 0 on success, otherwise an error code.
+         *               <code>ECANCELED</code> if the reception
+         *               was cancelled.
+         * @return <code>true</code> to continue receiving blocks,
+         *         <code>false</code> to stop. The return value is
+         *         ignored if <code>errnum</code> isn't 0.
+         */
+        using block_cb_t = std::function<bool (PacketSocketConnection& conn,
+                                               const struct tpacket_block_desc* block,
+                                               int errnum)>;
+
+        /**
+         * Callback used by method <code>for_each_packet</code>.
+         * @param hdr The TPACKET_V3 header of the frame.
+         * @param frame The frame data, starting at the link layer header.
+         *              The number of captured bytes is <code>hdr.tp_snaplen</code>.
+         */
+        using packet_cb_t = std::function<void (const struct tpacket3_hdr& hdr,
+                                                const uint8_t* frame)>;
+
+        static constexpr unsigned default_block_size {1u << 18}; /**< Default size of a ring block, 256 KiB. */
+        static constexpr unsigned default_block_count {8};      /**< Default number of ring blocks, a 2 MiB ring. */
+        static constexpr unsigned default_frame_size {2048};    /**< Default frame size hint. */
+        static constexpr unsigned default_block_timeout {60};   /**< Default block retire timeout in milliseconds. */
+
+        /**
+         * Constructor.
+         * @param io_handler The iohandler_base object handling the I/O operations.
+         */
+        PacketSocketConnection (iohandler_base& io_handler);
+
+        /**
+         * Move constructor.
+         * @param rhs The PacketSocketConnection object to move.
+         */
+        PacketSocketConnection (PacketSocketConnection&& rhs);
+
+        /**
+         * Destructor.
+         * Unmaps the receive ring and closes the socket.
+         */
+        virtual ~PacketSocketConnection ();
+
+        /**
+         * Move operator.
+         * @param rhs The PacketSocketConnection object to move.
+         * @return A reference to this object.
+         */
+        PacketSocketConnection& operator= (PacketSocketConnection&& rhs);
+
+        /**
+         * Open a packet socket and set up the receive ring.
+         * The default ring of 2 MiB is meant for moderate traffic.
+         * For capturing at high rates, use larger and more blocks.
+         * Keep in mind that each socket has its own ring, also each
+         * member of a fanout group.
+         * @param ifname The name of the network interface to bind to.
+         *               If empty, packets from all interfaces are received.
+         * @param protocol The ethernet protocol, in host byte order,
+         *                 to receive. Default is all protocols.
+         * @param block_size The size of each ring block.
+         *                   Must be a multiple of the page size.
+         * @param block_count The number of blocks in the ring.
+         * @param block_timeout Timeout in milliseconds after which the
+         *                      kernel hands over a block that isn't full.
+         * @param frame_size Frame size hint. Must be a multiple of
+         *                   <code>TPACKET_ALIGNMENT</code>.
+         * @param populate If <code>true</code>, the whole ring is
+         *                 faulted in when mapped (<code>MAP_POPULATE</code>),
+         *                 avoiding page faults when the first packets
+         *                 arrive at the cost of committing the memory up front.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        int open (const std::string& ifname="",
+                  int protocol=0x0003, // ETH_P_ALL
+                  unsigned block_size=default_block_size,
+                  unsigned block_count=default_block_count,
+                  unsigned block_timeout=default_block_timeout,
+                  unsigned frame_size=default_frame_size,
+                  bool populate=false);
+
+        /**
+         * Unmap the receive ring and close the socket.
+         */
+        virtual void close ();
+
+        /**
+         * Join a fanout group.
+         * Sockets in the same fanout group share the received traffic,
+         * for example one socket per I/O handler thread.
+         * @param group_id The fanout group id (0 - 65535).
+         * @param mode The fanout mode, like <code>PACKET_FANOUT_HASH</code>,
+         *             <code>PACKET_FANOUT_LB</code>, or <code>PACKET_FANOUT_CPU</code>.
+         * @param flags Fanout flags, like <code>PACKET_FANOUT_FLAG_DEFRAG</code>.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        int fanout (unsigned group_id, int mode=PACKET_FANOUT_HASH, int flags=0);
+
+        /**
+         * Start receiving blocks of frames.
+         * The callback is called for each block that the
+         * kernel hands over to the application, until the
+         * callback returns <code>false</code>, an error occurs,
+         * or the operation is cancelled.
+         * @param block_cb The callback called for each block.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        int start_rx (block_cb_t block_cb);
+
+        /**
+         * Get and reset the packet statistics of the socket.
+         * @param stats The statistics of the socket.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        int stats (struct tpacket_stats_v3& stats);
+
+        /**
+         * Iterate the frames in a block.
+         * @param block A block of frames.
+         * @param packet_cb Called for each frame in the block.
+         * @return The number of frames in the block.
+         */
+        static unsigned for_each_packet (const struct tpacket_block_desc& block,
+                                         packet_cb_t packet_cb);
+
+
+    private:
+        void handle_rx (block_cb_t block_cb, int errnum);
+
+        uint8_t* ring;
+        size_t   ring_size;
+        unsigned blk_size;
+        unsigned blk_count;
+        unsigned cur_blk;
+    };
+
+
+}
+#endif
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/PtyConnection.hpp>
+#include <iomultiplex/iohandler_base.hpp>
+#include <iomultiplex/Log.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+
+
+namespace iomultiplex {
+
+#define THIS_FILE "PtyConnection"
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    PtyConnection::PtyConnection (iohandler_base& io_handler, size_t rx_buffer_size)
+        : FdConnection (io_handler),
+          name (""),
+          rx_buf_size {rx_buffer_size ? rx_buffer_size : default_rx_buffer_size}
+    {
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    PtyConnection::PtyConnection (PtyConnection&& pc)
+        : FdConnection (std::move(pc)),
+          name {std::move(pc.name)},
+          rx_buf {std::move(pc.rx_buf)},
+          rx_buf_size {pc.rx_buf_size}
+    {
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    PtyConnection& PtyConnection::operator= (PtyConnection&& pc)
+    {
+        if (this != &pc) {
+            FdConnection::operator= (std::move(pc));
+            name = std::move (pc.name);
+            rx_buf = std::move (pc.rx_buf);
+            rx_buf_size = pc.rx_buf_size;
+        }
+        return *this;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int PtyConnection::open (bool raw)
+    {
+        if (fd.load() != -1) {
+            errno = 0;
+            return 0;
+        }
+
+        int master = posix_openpt (O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (master < 0)
+            return -1;
+
+        char buf[64];
+        if (grantpt(master) || unlockpt(master) || ptsname_r(master, buf, sizeof(buf))) {
+            int errnum = errno;
+            Log::warning (THIS_FILE " - Unable to initialize pseudo-terminal: %s",
+                          strerror(errnum));
+            ::close (master);
+            errno = errnum;
+            return -1;
+        }
+        fd = master;
+        name = buf;
+
+        if (raw) {
+            termios_cfg tio;
+            if (get_cfg(tio) == 0) {
+                tio.set_raw ();
+                set_cfg (tio);
+            }
+        }
+
+        errno = 0;
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void PtyConnection::close ()
+    {
+        FdConnection::close ();
+        name = "";
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    const std::string& PtyConnection::slave_name () const
+    {
+        return name;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int PtyConnection::open_slave (int flags)
+    {
+        if (name.empty()) {
+            errno = EBADF;
+            return -1;
+        }
+        return ::open (name.c_str(), O_RDWR | O_NOCTTY | flags);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int PtyConnection::get_cfg (termios_cfg& cfg)
+    {
+        return tcgetattr (fd, &cfg);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int PtyConnection::set_cfg (const termios_cfg& cfg)
+    {
+        return tcsetattr (fd, TCSANOW, &cfg);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int PtyConnection::window_size (struct winsize& ws)
+    {
+        return ioctl (fd, TIOCGWINSZ, &ws);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int PtyConnection::window_size (unsigned short rows,
+                                    unsigned short cols,
+                                    unsigned short xpixel,
+                                    unsigned short ypixel)
+    {
+        struct winsize ws;
+        ws.ws_row    = rows;
+        ws.ws_col    = cols;
+        ws.ws_xpixel = xpixel;
+        ws.ws_ypixel = ypixel;
+        return ioctl (fd, TIOCSWINSZ, &ws);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int PtyConnection::start_rx (io_callback_t rx_cb)
+    {
+        if (!rx_buf)
+            rx_buf.reset (new char[rx_buf_size]);
+
+        return read (rx_buf.get(), rx_buf_size, [this, rx_cb](io_result_t& ior)->bool{
+                return on_rx (ior, rx_cb);
+            });
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Called in I/O handler context
+    //--------------------------------------------------------------------------
+    bool PtyConnection::on_rx (io_result_t& ior, io_callback_t rx_cb)
+    {
+        auto io_cb = rx_cb != nullptr ? rx_cb : def_rx_cb();
+        bool keep_reading = io_cb ? io_cb(ior) : true;
+
+        if (ior.result<=0 || !keep_reading)
+            return false;
+
+        // Queue the next read operation and let the I/O handler
+        // continue reading until there is no more data available.
+        return read (rx_buf.get(), rx_buf_size, [this, rx_cb](io_result_t& ior)->bool{
+                return on_rx (ior, rx_cb);
+            }) == 0;
+    }
+
+
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_PTYCONNECTION_HPP
+#define IOMULTIPLEX_PTYCONNECTION_HPP
+
+#include <iomultiplex/FdConnection.hpp>
+#include <iomultiplex/termios_cfg.hpp>
+#include <string>
+#include <memory>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+
+
+namespace iomultiplex {
+
+    // Forward declaration
+    class iohandler_base;
+
+
+    /**
+     * Pseudo-terminal connection.
+     * This is the master side of a pseudo-terminal pair.
+     * The slave side is a terminal device, named by method
+     * <code>slave_name</code>, that can be used by a child
+     * process or by a SerialConnection object.
+     */
+    class PtyConnection : public FdConnection {
+    public:
+        static constexpr size_t default_rx_buffer_size {65536}; /**< Default buffer size used by method <code>start_rx</code>. */
+
+        /**
+         * Constructor.
+         * @param io_handler This object will manage I/O operations for this connection.
+         * @param rx_buffer_size The size of the buffer used by method <code>start_rx</code>.
+         */
+        PtyConnection (iohandler_base& io_handler, size_t rx_buffer_size=default_rx_buffer_size);
+
+        /**
+         * Move Constructor.
+         * All read/write operations that has been queued
+         * by the object to be moved will be cancelled.
+         * @param pc The PtyConnection object to move.
+         */
+        PtyConnection (PtyConnection&& pc);
+
+        /**
+         * Destructor.
+         * All pending I/O operations will be cancelled and the connection will be closed.
+         */
+        virtual ~PtyConnection () = default;
+
+        /**
+         * Move operator.
+         * All read/write operations that has been queued by either
+         * this object or the object to be moved will be cancelled.
+         * @param pc The PtyConnection object to move.
+         * @return A reference to this object.
+         */
+        PtyConnection& operator= (PtyConnection&& pc);
+
+        /**
+         * Open a new pseudo-terminal master.
+         * @param raw If <code>true</code>, put the terminal in raw mode.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int open (bool raw=false);
+
+        /**
+         * Close the pseudo-terminal master.
+         * Cancel all pending I/O operations and close the connection.
+         */
+        virtual void close ();
+
+        /**
+         * Return the name of the slave terminal device.
+         * @return The name of the slave device, or an empty
+         *         string if the pseudo-terminal isn't open.
+         */
+        const std::string& slave_name () const;
+
+        /**
+         * Open the slave terminal device.
+         * @param flags Flags passed to <code>open()</code> in addition to
+         *              <code>O_RDWR</code> and <code>O_NOCTTY</code>.
+         * @return An open file descriptor, or -1 on failure
+         *         and <code>errno</code> is set.
+         */
+        int open_slave (int flags=0);
+
+        /**
+         * Get the terminal attributes of the pseudo-terminal.
+         * @param cfg A reference to a termios_cfg structure to
+         *            store the terminal attributes.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int get_cfg (termios_cfg& cfg);
+
+        /**
+         * Set the terminal attributes of the pseudo-terminal.
+         * @param cfg A reference to a termios_cfg structure with
+         *            the terminal attributes we want to set.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int set_cfg (const termios_cfg& cfg);
+
+        /**
+         * Get the window size of the pseudo-terminal.
+         * @param ws A reference to a winsize structure to
+         *           store the window size.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int window_size (struct winsize& ws);
+
+        /**
+         * Set the window size of the pseudo-terminal.
+         * The foreground process group of the slave
+         * terminal will receive a <code>SIGWINCH</code> signal.
+         * @param rows Number of rows.
+         * @param cols Number of columns.
+         * @param xpixel Horizontal size in pixels (normally unused).
+         * @param ypixel Vertical size in pixels (normally unused).
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int window_size (unsigned short rows,
+                         unsigned short cols,
+                         unsigned short xpixel=0,
+                         unsigned short ypixel=0);
+
+        /**
+         * Continuously read data from the pseudo-terminal.
+         * Data is read into an internal buffer of the size given
+         * in the constructor, and all data available is read in
+         * one go before waiting for new events.
+         * The callback is called for each read. If the callback
+         * returns <code>false</code>, or the read operation fails
+         * (<code>ior.result</code> <= 0), no more data is read.
+         * \note <code>ior.buf</code> is only valid in the callback.
+         * \note When the last file descriptor of the slave
+         *       device is closed, the read fails with
+         *       <code>errnum</code> set to <code>EIO</code>.
+         * @param rx_cb The callback to be called for each read.
+         * @return 0 on success, -1 if the read operation can't be queued.
+         */
+        int start_rx (io_callback_t rx_cb);
+
+
+    private:
+        PtyConnection () = delete;
+        PtyConnection (const PtyConnection& pc) = delete;
+        PtyConnection& operator= (const PtyConnection& pc) = delete;
+
+        bool on_rx (io_result_t& ior, io_callback_t rx_cb);
+
+        std::string name;
+        std::unique_ptr<char[]> rx_buf;
+        size_t rx_buf_size;
+    };
+
+
+}
+#endif
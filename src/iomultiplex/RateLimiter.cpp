@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/RateLimiter.hpp>
+#include <algorithm>
+#include <ctime>
+
+
+namespace iomultiplex {
+
+
+    // Wait until at least this fraction of a second's
+    // worth of bytes is available, not to make the
+    // I/O operations smaller than they have to be.
+    static constexpr double min_chunk = 0.01;
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    static uint64_t monotonic_ns ()
+    {
+        struct timespec ts;
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    RateLimiter::RateLimiter (uint64_t bytes_per_sec,
+                              uint64_t ops_per_sec,
+                              std::shared_ptr<RateLimiter> parent)
+        : parent_rl {parent},
+          bytes {0, 0, 0},
+          ops {0, 0, 0},
+          last_refill {monotonic_ns()},
+          num_deferred {0}
+    {
+        rate (bytes_per_sec, ops_per_sec);
+        // Start with full buckets
+        bytes.tokens = bytes.capacity;
+        ops.tokens = ops.capacity;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void RateLimiter::rate (uint64_t bytes_per_sec, uint64_t ops_per_sec)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        refill (monotonic_ns());
+
+        bytes.rate = (double) bytes_per_sec;
+        bytes.capacity = std::max (1.0, bytes.rate / 10.0);
+        bytes.tokens = std::min (bytes.tokens, bytes.capacity);
+
+        ops.rate = (double) ops_per_sec;
+        ops.capacity = std::max (1.0, ops.rate / 10.0);
+        ops.tokens = std::min (ops.tokens, ops.capacity);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void RateLimiter::burst (uint64_t num_bytes, uint64_t num_ops)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        refill (monotonic_ns());
+
+        bytes.capacity = (double) std::max (num_bytes, (uint64_t)1);
+        bytes.tokens = std::min (bytes.tokens, bytes.capacity);
+        ops.capacity = (double) std::max (num_ops, (uint64_t)1);
+        ops.tokens = std::min (ops.tokens, ops.capacity);
+    }
+
+
+    //--------------------------------------------------------------------------
+    // mutex is locked!
+    //--------------------------------------------------------------------------
+    void RateLimiter::refill (uint64_t now)
+    {
+        if (now <= last_refill)
+            return;
+        double elapsed = (double)(now - last_refill) / 1e9;
+        last_refill = now;
+
+        for (auto* bucket : {&bytes, &ops}) {
+            if (bucket->rate > 0)
+                bucket->tokens = std::min (bucket->capacity,
+                                           bucket->tokens + bucket->rate * elapsed);
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    // mutex is locked!
+    //--------------------------------------------------------------------------
+    uint64_t RateLimiter::check (size_t& size, bool data, bool partial, uint64_t now)
+    {
+        refill (now);
+
+        double delay = 0;
+        if (ops.rate > 0 && ops.tokens < 1.0)
+            delay = (1.0 - ops.tokens) / ops.rate;
+
+        if (data && bytes.rate > 0 && size > 0) {
+            // Don't allow less than min_chunk seconds
+            // worth of data, unless that is all we need.
+            // If the operation can't be split, wait for
+            // all of it, but not more than a full bucket.
+            double needed = std::min ((double)size,
+                                      partial ?
+                                      std::min(bytes.capacity, std::max(1.0, bytes.rate * min_chunk)) :
+                                      bytes.capacity);
+            if (bytes.tokens < needed)
+                delay = std::max (delay, (needed - bytes.tokens) / bytes.rate);
+            else if (partial && (double)size > bytes.tokens)
+                size = (size_t) bytes.tokens;
+        }
+
+        if (delay <= 0)
+            return 0;
+        ++num_deferred;
+        return std::max ((uint64_t)(delay * 1e9), (uint64_t)1);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    uint64_t RateLimiter::reserve (size_t& size, bool data, bool partial)
+    {
+        auto now = monotonic_ns ();
+        uint64_t delay = 0;
+        for (auto* rl = this; rl; rl = rl->parent_rl.get()) {
+            std::lock_guard<std::mutex> lock (rl->mutex);
+            delay = std::max (delay, rl->check(size, data, partial, now));
+        }
+        return delay;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void RateLimiter::consume (size_t num_bytes)
+    {
+        auto now = monotonic_ns ();
+        for (auto* rl = this; rl; rl = rl->parent_rl.get()) {
+            std::lock_guard<std::mutex> lock (rl->mutex);
+            rl->refill (now);
+            if (rl->ops.rate > 0)
+                rl->ops.tokens -= 1.0;
+            if (rl->bytes.rate > 0)
+                rl->bytes.tokens -= (double) num_bytes;
+        }
+    }
+
+
+}
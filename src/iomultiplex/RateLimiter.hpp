@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_RATELIMITER_HPP
+#define IOMULTIPLEX_RATELIMITER_HPP
+
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+
+namespace iomultiplex {
+
+
+    /**
+     * A token bucket rate limiter for I/O operations.
+     * The limiter has one bucket for bytes and one for operations,
+     * refilled at a constant rate up to a burst size. A rate of 0
+     * means that the bucket doesn't limit anything.
+     * <br/>
+     * Limiters can be chained in a hierarchy by giving a limiter a
+     * parent. An I/O operation is then limited by the limiter and
+     * all its ancestors, and the transferred data is counted in all
+     * of them. For example, each connection of a tenant can have its
+     * own limiter, with a shared limiter for the whole tenant as parent.
+     * <br/>
+     * A limiter is attached to a connection, or to all connections
+     * of an I/O handler, with method <code>iohandler_base::rate_limit</code>.
+     * The same limiter may be used by several I/O handlers, all
+     * methods are thread safe.
+     */
+    class RateLimiter {
+    public:
+        /**
+         * Constructor.
+         * The burst sizes are set to 100 milliseconds worth of each rate,
+         * see method <code>burst</code>.
+         * @param bytes_per_sec The maximum number of bytes per second,
+         *                      0 for no limit.
+         * @param ops_per_sec The maximum number of I/O operations per
+         *                    second, 0 for no limit.
+         * @param parent A limiter that also limits the I/O operations
+         *               using this limiter, or <code>nullptr</code>.
+         */
+        RateLimiter (uint64_t bytes_per_sec,
+                     uint64_t ops_per_sec=0,
+                     std::shared_ptr<RateLimiter> parent=nullptr);
+
+        /**
+         * Change the rates.
+         * The burst sizes are set to 100 milliseconds worth of each rate.
+         * @param bytes_per_sec The maximum number of bytes per second,
+         *                      0 for no limit.
+         * @param ops_per_sec The maximum number of I/O operations per
+         *                    second, 0 for no limit.
+         */
+        void rate (uint64_t bytes_per_sec, uint64_t ops_per_sec=0);
+
+        /**
+         * Set the burst sizes.
+         * The burst size is the number of tokens that can be saved up
+         * while idle, and is the most that is transferred at once.
+         * @param bytes The burst size in bytes, at least 1.
+         * @param ops The burst size in I/O operations, at least 1.
+         */
+        void burst (uint64_t bytes, uint64_t ops=1);
+
+        /**
+         * Get the parent limiter.
+         * @return The parent limiter, or <code>nullptr</code>.
+         */
+        std::shared_ptr<RateLimiter> parent () const {
+            return parent_rl;
+        }
+
+        /**
+         * Check if an I/O operation may be done now.
+         * If the operation may be done, and <code>partial</code> is
+         * <code>true</code>, <code>size</code> is reduced to the
+         * number of bytes this limiter, and its ancestors, allow
+         * right now.
+         * No tokens are used, call method <code>consume</code>
+         * when the I/O operation is done.
+         * @param size The number of bytes to transfer.
+         *             Updated with the number of bytes allowed.
+         * @param data <code>false</code> if no data is transferred,
+         *             only the number of operations is then limited.
+         * @param partial <code>false</code> if the operation can't be
+         *                split, like reading or writing a datagram.
+         *                <code>size</code> is then left as is, and the
+         *                operation waits until all of it is allowed,
+         *                or at most a full burst. A larger operation
+         *                puts the limiter in debt.
+         * @return 0 if the I/O operation may be done now, otherwise
+         *         the number of nanoseconds until it may be done.
+         */
+        uint64_t reserve (size_t& size, bool data=true, bool partial=true);
+
+        /**
+         * Use tokens for a finished I/O operation.
+         * One operation and <code>bytes</code> bytes are used in
+         * this limiter and all its ancestors.
+         * @param bytes The number of bytes transferred.
+         */
+        void consume (size_t bytes);
+
+        /**
+         * Get the number of times an I/O operation had to wait for this limiter.
+         * @return The number of deferred I/O operations.
+         */
+        uint64_t deferred () const {
+            return num_deferred.load (std::memory_order_relaxed);
+        }
+
+
+    private:
+        // A single token bucket
+        struct bucket_t {
+            double rate;     // Tokens per second, 0 if unlimited
+            double capacity; // Burst size
+            double tokens;   // Available tokens, negative if in debt
+        };
+
+        void refill (uint64_t now);
+        uint64_t check (size_t& size, bool data, bool partial, uint64_t now);
+
+        std::shared_ptr<RateLimiter> parent_rl;
+        std::mutex mutex;
+        bucket_t bytes;
+        bucket_t ops;
+        uint64_t last_refill; // Monotonic time in nanoseconds
+        std::atomic<uint64_t> num_deferred;
+    };
+
+
+}
+#endif
@@ -18,9 +18,14 @@
  */
 #include <iomultiplex/SerialConnection.hpp>
 #include <iomultiplex/iohandler_base.hpp>
+#include <iomultiplex/termios2.hpp>
 #include <iomultiplex/Log.hpp>
+#include <memory>
 #include <cstring>
+#include <cerrno>
 #include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
 
 
 namespace iomultiplex {
@@ -130,8 +135,10 @@ namespace iomultiplex {
         }
 
         // Set baud rate
+        // (non-standard baud rates are set after the other settings)
         //
-        if (fd >= 0) {
+        bool custom_baud_rate = !termios_cfg::is_standard_speed (baud_rate);
+        if (fd >= 0 && !custom_baud_rate) {
             if (tio.speed(baud_rate)) {
                 errnum = errno;
                 Log::warning (THIS_FILE " - Unable to set baud rate for %s - %s",
@@ -188,6 +195,18 @@ namespace iomultiplex {
             }
         }
 
+        // Set a non-standard baud rate
+        //
+        if (fd >= 0 && custom_baud_rate) {
+            if (custom_speed(baud_rate)) {
+                errnum = errno;
+                Log::warning (THIS_FILE " - Unable to set custom baud rate %d for %s - %s",
+                              baud_rate, name.c_str(), strerror(errnum));
+                ::close (fd);
+                fd = -1;
+            }
+        }
+
         errno = errnum;
         return fd<0 ? -1 : 0;
     }
@@ -209,4 +228,227 @@ namespace iomultiplex {
     }
 
 
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SerialConnection::custom_speed (int baud_rate)
+    {
+        return termios2_set_speed (fd, baud_rate);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SerialConnection::custom_speed ()
+    {
+        return termios2_get_speed (fd);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SerialConnection::low_latency (bool on)
+    {
+        struct serial_struct ss;
+        if (ioctl(fd, TIOCGSERIAL, &ss))
+            return -1;
+        if (on)
+            ss.flags |= ASYNC_LOW_LATENCY;
+        else
+            ss.flags &= ~ASYNC_LOW_LATENCY;
+        return ioctl (fd, TIOCSSERIAL, &ss);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SerialConnection::rx_batch (unsigned min_bytes, unsigned inter_byte_timeout)
+    {
+        if (min_bytes == 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        termios_cfg tio;
+        if (get_cfg(tio))
+            return -1;
+        if (tio.vmin(min_bytes) || tio.vtime(inter_byte_timeout))
+            return -1;
+        return set_cfg (tio);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    unsigned SerialConnection::frame_gap (int baud_rate, unsigned bits_per_char)
+    {
+        if (baud_rate <= 0)
+            return 0;
+        if (baud_rate > 19200)
+            return 2;
+        // 3.5 character times in milliseconds, rounded up
+        unsigned long bits = 35UL * bits_per_char;
+        return (unsigned) ((bits * 100UL + (unsigned long)baud_rate - 1UL) / (unsigned long)baud_rate);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    bool SerialConnection::frame_rx_cb (io_result_t& ior,
+                                        void* buf, // The original read buffer
+                                        size_t size,
+                                        size_t cur_size,
+                                        unsigned gap,
+                                        io_callback_t io_cb,
+                                        unsigned timeout)
+    {
+        if (ior.result > 0) {
+            cur_size += (size_t) ior.result;
+        }
+        else if (ior.errnum==ETIMEDOUT && cur_size>0) {
+            // The inter-frame gap has passed.
+            // When using VMIN batching, there may still be bytes
+            // in the input queue that never made the device readable.
+            int errnum = 0;
+            ssize_t result = do_read (((char*)buf)+cur_size, size-cur_size, errnum);
+            if (result <= 0) {
+                // End of frame
+                ior.buf = buf;
+                ior.size = size;
+                ior.result = (ssize_t) cur_size;
+                ior.errnum = 0;
+                ior.timeout = timeout;
+                return io_cb ? io_cb(ior) : false;
+            }
+            cur_size += (size_t) result;
+        }
+        else {
+            // Error, end of file, cancelled, or
+            // a timeout before any data was received
+            auto result = ior.result;
+            auto errnum = ior.errnum;
+            ior.buf = buf;
+            ior.size = size;
+            ior.timeout = timeout;
+            if (cur_size > 0) {
+                // Report the partial frame before the error or end of file
+                ior.result = (ssize_t) cur_size;
+                ior.errnum = 0;
+                if (io_cb)
+                    io_cb (ior);
+                ior.result = result;
+                ior.errnum = errnum;
+            }
+            return io_cb ? io_cb(ior) : false;
+        }
+
+        if (cur_size >= size) {
+            // The buffer is full
+            ior.buf = buf;
+            ior.size = size;
+            ior.result = (ssize_t) cur_size;
+            ior.errnum = 0;
+            ior.timeout = timeout;
+            return io_cb ? io_cb(ior) : false;
+        }
+
+        // Wait for more data, or the end of the frame
+        if (Connection::read(((char*)buf)+cur_size,
+                             size-cur_size,
+                             [this, buf, size, cur_size, gap, io_cb, timeout](io_result_t& ior)->bool
+                                 {
+                                     return frame_rx_cb (ior, buf, size, cur_size,
+                                                         gap, io_cb, timeout);
+                                 },
+                             gap))
+        {
+            // Report the partial frame before the error
+            int errnum = errno;
+            ior.buf = buf;
+            ior.size = size;
+            ior.result = (ssize_t) cur_size;
+            ior.errnum = 0;
+            ior.timeout = timeout;
+            if (io_cb)
+                io_cb (ior);
+            ior.result = -1;
+            ior.errnum = errnum;
+            return io_cb ? io_cb(ior) : false;
+        }
+        return true;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Asynchronized operation
+    //--------------------------------------------------------------------------
+    int SerialConnection::read_frame (void* buf,
+                                      size_t size,
+                                      unsigned gap,
+                                      io_callback_t rx_cb,
+                                      unsigned timeout)
+    {
+        if (size == 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        auto io_cb = rx_cb != nullptr ? rx_cb : def_rx_cb();
+        return Connection::read (buf,
+                                 size,
+                                 [this, buf, size, gap, io_cb, timeout](io_result_t& ior)->bool
+                                     {
+                                         return frame_rx_cb (ior, buf, size, 0,
+                                                             gap, io_cb, timeout);
+                                     },
+                                 timeout);
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Synchronized operation
+    // (assumes the I/O handler running in another thread)
+    //--------------------------------------------------------------------------
+    ssize_t SerialConnection::read_frame (void* buf,
+                                          size_t size,
+                                          unsigned gap,
+                                          unsigned timeout)
+    {
+        if (io_handler().same_context()) {
+            errno = EDEADLK;
+            return -1;
+        }
+        auto& sync = sync_state ();
+        // A partial frame is followed by a second callback with the
+        // error or end of file, after this method has returned.
+        // Keep the result where the second callback can't harm.
+        struct frame_result_t {
+            ssize_t result {-1};
+            int errnum {0};
+            bool io_done {false};
+        };
+        auto fr = std::make_shared<frame_result_t> ();
+        // Queue a frame read operation
+        if (read_frame(buf,
+                       size,
+                       gap,
+                       [fr, &sync](io_result_t& ior)->bool{
+                           // Called from iohandler_base
+                           std::unique_lock<std::mutex> lock (sync.mutex);
+                           if (fr->io_done)
+                               return false; // Only the first result is used
+                           fr->result = ior.result;
+                           fr->errnum = ior.errnum;
+                           fr->io_done = true;
+                           sync.cond.notify_one ();
+                           return false;
+                       },
+                       timeout) == 0)
+        {
+            // Wait for the frame to be read or timeout
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&fr]{return fr->io_done;});
+            errno = fr->errnum;
+        }
+        return fr->result;
+    }
+
+
 }
@@ -130,12 +130,117 @@ namespace iomultiplex {
          */
         int set_cfg (const termios_cfg& cfg);
 
+        /**
+         * Set a custom baud rate.
+         * This sets the baud rate using <code>termios2</code> and
+         * <code>BOTHER</code>, and can be used for baud rates that
+         * don't have a standard <code>Bxxx</code> speed value.
+         * Method <code>open</code> calls this method if the requested
+         * baud rate isn't a standard baud rate.
+         * \note A later call to <code>set_cfg</code> may reset the baud rate.
+         * @param baud_rate The baud rate.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int custom_speed (int baud_rate);
+
+        /**
+         * Get the current baud rate, including custom baud rates.
+         * @return The baud rate, or -1 on failure and <code>errno</code> is set.
+         */
+        int custom_speed ();
+
+        /**
+         * Set or clear the low latency flag (<code>ASYNC_LOW_LATENCY</code>)
+         * of the serial driver.
+         * When set, the driver passes received data to the line
+         * discipline immediately instead of buffering it.
+         * Not all serial drivers support this.
+         * @param on <code>true</code> to set the low latency flag.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         *         If the device doesn't support the flag, <code>errno</code>
+         *         is normally set to <code>ENOTTY</code> or <code>EINVAL</code>.
+         */
+        int low_latency (bool on);
+
+        /**
+         * Batch the reception of data using VMIN/VTIME.
+         * With <code>inter_byte_timeout</code> set to 0, the serial device
+         * isn't reported readable until at least <code>min_bytes</code> bytes
+         * are received, which reduces the number of wakeups on busy lines.
+         * Bytes less than <code>min_bytes</code> at the end of a
+         * transmission won't make the device readable, use method
+         * <code>read_frame</code>, or a read timeout followed by a
+         * call to <code>do_read</code>, to get them.
+         * @param min_bytes The value of VMIN (1-255).
+         * @param inter_byte_timeout The value of VTIME in deciseconds (0-255).
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int rx_batch (unsigned min_bytes, unsigned inter_byte_timeout=0);
+
+        /**
+         * Queue a read operation of a frame delimited by an inter-byte gap.
+         * This is used for protocols like Modbus RTU, where the end of a
+         * frame is detected by a period of silence on the line.
+         * The callback is called when no data has been received for
+         * <code>gap</code> milliseconds after the first byte, when the
+         * buffer is full, or on error. On success, <code>ior.result</code>
+         * is the size of the frame. If an error or end of file occurs
+         * after part of a frame is received, the callback is first
+         * called with the partial frame, and then with the error.
+         * @param buf The buffer where to store the frame.
+         * @param size The maximum size of the frame.
+         * @param gap The inter-frame gap in milliseconds.
+         * @param rx_cb If not <code>nullptr</code>, this callback is called
+         *              when the frame is read, an error occurred, or the
+         *              operation timed out before any data was received.
+         *              If <code>nullptr</code>, the default read
+         *              operation callback is called if one is set.
+         * @param timeout A timeout in milliseconds to wait for the first byte.
+         *                If -1, no timeout is set.
+         * @return 0 on success, -1 if the read operation can't be queued.
+         * @see frame_gap
+         */
+        int read_frame (void* buf, size_t size, unsigned gap,
+                        io_callback_t rx_cb, unsigned timeout=-1);
+
+        /**
+         * Synchronized read of a frame delimited by an inter-byte gap.
+         * @param buf The buffer where to store the frame.
+         * @param size The maximum size of the frame.
+         * @param gap The inter-frame gap in milliseconds.
+         * @param timeout A timeout in milliseconds to wait for the first byte.
+         *                If -1, no timeout is set.
+         * @return The size of the frame, or -1 on error
+         *         and <code>errno</code> is set.
+         */
+        ssize_t read_frame (void* buf, size_t size, unsigned gap, unsigned timeout=-1);
+
+        /**
+         * Calculate the inter-frame gap of 3.5 character times,
+         * as used by Modbus RTU.
+         * For baud rates above 19200, a fixed value of 2 milliseconds
+         * is returned (1.75 ms rounded up).
+         * @param baud_rate The baud rate.
+         * @param bits_per_char The number of bits per character,
+         *                      including start, parity, and stop bits.
+         * @return The gap in milliseconds, rounded up.
+         */
+        static unsigned frame_gap (int baud_rate, unsigned bits_per_char=11);
+
 
     private:
         SerialConnection () = delete;
         SerialConnection (const SerialConnection& fc) = delete;
         SerialConnection& operator= (const SerialConnection& fc) = delete;
 
+        bool frame_rx_cb (io_result_t& ior,
+                          void* buf,
+                          size_t size,
+                          size_t cur_size,
+                          unsigned gap,
+                          io_callback_t rx_cb,
+                          unsigned timeout);
+
         std::string name;
     };
 
@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/SimConnection.hpp>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+
+namespace iomultiplex {
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    SimConnection::SimConnection (SimIOHandler& io_handler, bool datagram_mode)
+        : ioh {io_handler},
+          id {-1},
+          peer_id {-1},
+          datagram {datagram_mode},
+          eof {false},
+          peer_closed {false},
+          rx_pos {0},
+          rx_bytes {0},
+          sndbuf {default_send_buffer},
+          tx_queued {0},
+          link_free {0},
+          last_arrival {0}
+    {
+        std::lock_guard<std::mutex> lock (ioh.mutex);
+        link_props = ioh.def_link;
+        id = ++ioh.next_handle;
+        ioh.conns.emplace (id, this);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    SimConnection::~SimConnection ()
+    {
+        close ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SimConnection::connect (SimConnection& peer)
+    {
+        std::lock_guard<std::mutex> lock (ioh.mutex);
+        if (id < 0 || peer.id < 0) {
+            errno = EBADF;
+            return -1;
+        }
+        if (&peer == this || &peer.ioh != &ioh || peer.datagram != datagram) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (peer_id >= 0 || peer.peer_id >= 0 || peer_closed || peer.peer_closed) {
+            errno = EISCONN;
+            return -1;
+        }
+        peer_id = peer.id;
+        peer.peer_id = id;
+
+        // Queued write operations can now be performed
+        ioh.kick (id, false);
+        ioh.kick (peer.id, false);
+        errno = 0;
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SimConnection::link (const SimIOHandler::link_t& link)
+    {
+        std::lock_guard<std::mutex> lock (ioh.mutex);
+        link_props = link;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SimConnection::send_buffer_size (size_t size)
+    {
+        std::lock_guard<std::mutex> lock (ioh.mutex);
+        sndbuf = size ? size : 1;
+        if (id >= 0)
+            ioh.kick (id, false);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    size_t SimConnection::available ()
+    {
+        std::lock_guard<std::mutex> lock (ioh.mutex);
+        return rx_bytes;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    bool SimConnection::is_connected ()
+    {
+        std::lock_guard<std::mutex> lock (ioh.mutex);
+        return peer_id >= 0 && !peer_closed;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SimConnection::handle ()
+    {
+        return id;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    bool SimConnection::is_open () const
+    {
+        return id >= 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    iohandler_base& SimConnection::io_handler ()
+    {
+        return ioh;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SimConnection::cancel (bool cancel_rx, bool cancel_tx, bool fast)
+    {
+        ioh.cancel (*this, cancel_rx, cancel_tx, fast);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SimConnection::close ()
+    {
+        if (id < 0)
+            return;
+        ioh.cancel (*this);
+
+        std::lock_guard<std::mutex> lock (ioh.mutex);
+        int my_id = id.exchange (-1);
+        if (my_id < 0)
+            return;
+        ioh.conns.erase (my_id);
+
+        if (peer_id >= 0 && !peer_closed) {
+            auto entry = ioh.conns.find (peer_id);
+            if (entry != ioh.conns.end()) {
+                // The peer can't write any more, and reads end
+                // of file when all data sent to it has arrived.
+                entry->second->peer_closed = true;
+                ioh.kick (peer_id, false);
+
+                auto arrival = std::max (ioh.clock + link_props.latency, last_arrival);
+                auto* handler = &ioh;
+                int pid = peer_id;
+                ioh.post (arrival, [handler, pid]{
+                        std::lock_guard<std::mutex> lock (handler->mutex);
+                        auto entry = handler->conns.find (pid);
+                        if (entry == handler->conns.end())
+                            return;
+                        entry->second->eof = true;
+                        handler->kick (pid, true);
+                    });
+            }
+        }
+        peer_id = -1;
+        rx_data.clear ();
+        rx_pos = 0;
+        rx_bytes = 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    ssize_t SimConnection::do_read (void* buf, size_t size, int& errnum)
+    {
+        std::lock_guard<std::mutex> lock (ioh.mutex);
+        if (id < 0) {
+            errnum = EBADF;
+            return -1;
+        }
+        if (rx_data.empty()) {
+            if (eof) {
+                errnum = 0;
+                return 0;
+            }
+            errnum = EAGAIN;
+            return -1;
+        }
+
+        errnum = 0;
+        if (datagram) {
+            // One message per read, truncated if the buffer is too small
+            auto& msg = rx_data.front ();
+            auto len = std::min (size, msg.size());
+            memcpy (buf, msg.data(), len);
+            rx_bytes -= msg.size ();
+            rx_data.pop_front ();
+            return (ssize_t) len;
+        }
+
+        auto* dst = static_cast<char*> (buf);
+        size_t num = 0;
+        while (num < size && !rx_data.empty()) {
+            auto& chunk = rx_data.front ();
+            auto len = std::min (size - num, chunk.size() - rx_pos);
+            memcpy (dst + num, chunk.data() + rx_pos, len);
+            num += len;
+            rx_pos += len;
+            if (rx_pos >= chunk.size()) {
+                rx_data.pop_front ();
+                rx_pos = 0;
+            }
+        }
+        rx_bytes -= num;
+        return (ssize_t) num;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    ssize_t SimConnection::do_write (const void* buf, size_t size, int& errnum)
+    {
+        std::lock_guard<std::mutex> lock (ioh.mutex);
+        if (id < 0) {
+            errnum = EBADF;
+            return -1;
+        }
+        if (peer_closed) {
+            errnum = EPIPE;
+            return -1;
+        }
+        if (peer_id < 0) {
+            errnum = ENOTCONN;
+            return -1;
+        }
+
+        size_t space = sndbuf > tx_queued ? sndbuf - tx_queued : 0;
+        size_t len;
+        if (datagram) {
+            if (size > sndbuf) {
+                errnum = EMSGSIZE;
+                return -1;
+            }
+            len = size;
+            if (len > space) {
+                errnum = EAGAIN;
+                return -1;
+            }
+        }else{
+            len = std::min (size, space);
+            if (len == 0 && size > 0) {
+                errnum = EAGAIN;
+                return -1;
+            }
+        }
+
+        transmit (static_cast<const char*>(buf), len);
+        errnum = 0;
+        return (ssize_t) len;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // I/O handler mutex is locked
+    //--------------------------------------------------------------------------
+    bool SimConnection::rx_ready () const
+    {
+        return !rx_data.empty() || eof;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // I/O handler mutex is locked
+    //--------------------------------------------------------------------------
+    bool SimConnection::tx_ready () const
+    {
+        // Writes fail right away if not connected
+        return peer_id < 0 || peer_closed || tx_queued < sndbuf;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // I/O handler mutex is locked
+    //--------------------------------------------------------------------------
+    void SimConnection::transmit (const char* data, size_t size)
+    {
+        static constexpr unsigned max_retransmits = 15;
+        auto* handler = &ioh;
+        int my_id = id;
+        int pid = peer_id;
+
+        // Time to send the data on the link, given the bandwidth
+        auto start = std::max (ioh.clock.load(), link_free);
+        uint64_t send_time = 0;
+        if (link_props.bandwidth)
+            send_time = (uint64_t) ((double)size * 1000000000.0 / (double)link_props.bandwidth);
+        link_free = start + send_time;
+        tx_queued += size;
+        ioh.stat_bytes_sent += size;
+
+        // The data leaves the send buffer when it is sent
+        ioh.post (link_free, [handler, my_id, size]{
+                std::lock_guard<std::mutex> lock (handler->mutex);
+                auto entry = handler->conns.find (my_id);
+                if (entry == handler->conns.end())
+                    return;
+                entry->second->tx_queued -= size;
+                handler->kick (my_id, false);
+            });
+
+        uint64_t arrival = link_free + link_props.latency;
+        if (datagram) {
+            if (ioh.lost(link_props.loss)) {
+                ++ioh.stat_lost;
+                return; // Dropped
+            }
+        }else{
+            // Lost segments are retransmitted, and delay all data after them
+            for (unsigned i=0; i<max_retransmits && ioh.lost(link_props.loss); ++i) {
+                ++ioh.stat_lost;
+                arrival += link_props.rto;
+            }
+            arrival = std::max (arrival, last_arrival);
+        }
+        last_arrival = std::max (last_arrival, arrival);
+
+        ioh.post (arrival, [handler, pid, payload=std::string(data, size)]() mutable {
+                std::lock_guard<std::mutex> lock (handler->mutex);
+                auto entry = handler->conns.find (pid);
+                if (entry == handler->conns.end())
+                    return; // Peer is closed
+                auto* peer = entry->second;
+                handler->stat_bytes_recv += payload.size ();
+                peer->rx_bytes += payload.size ();
+                peer->rx_data.emplace_back (std::move(payload));
+                handler->kick (pid, true);
+            });
+    }
+
+
+}
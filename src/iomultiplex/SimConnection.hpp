@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_SIMCONNECTION_HPP
+#define IOMULTIPLEX_SIMCONNECTION_HPP
+
+#include <iomultiplex/Connection.hpp>
+#include <iomultiplex/SimIOHandler.hpp>
+#include <string>
+#include <list>
+#include <cstdint>
+
+
+namespace iomultiplex {
+
+
+    /**
+     * A simulated connection.
+     * Two simulated connections are connected to each other
+     * as a pair, and data written to one of them is delivered to
+     * the other by the SimIOHandler after a simulated delay.
+     * No file descriptors are used, so a very large number of
+     * connections can be simulated.
+     * <br/>
+     * A stream connection behaves like a TCP connection, data
+     * is delivered in order and lost data is retransmitted.
+     * A datagram connection behaves like a UDP socket, each write
+     * is one message that is read in one read operation, and
+     * lost messages are dropped.
+     * <br/>
+     * A simulated connection can be used by adapters,
+     * like ChunkAdapter, in the same way as a socket.
+     * @see SimIOHandler
+     */
+    class SimConnection : public Connection {
+    public:
+        /**
+         * Default size of the send buffer.
+         */
+        static constexpr size_t default_send_buffer {256 * 1024};
+
+        /**
+         * Constructor.
+         * Creates an open, but not connected, simulated connection.
+         * @param io_handler The simulation I/O handler.
+         * @param datagram If <code>true</code>, the connection
+         *                 sends and receives messages instead
+         *                 of a byte stream.
+         */
+        SimConnection (SimIOHandler& io_handler, bool datagram=false);
+
+        /**
+         * Destructor.
+         * Closes the connection.
+         */
+        virtual ~SimConnection ();
+
+        /**
+         * Connect this connection to a peer.
+         * Both connections must be open, not connected, and use
+         * the same I/O handler and the same mode (stream or datagram).
+         * @param peer The peer connection.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        int connect (SimConnection& peer);
+
+        /**
+         * Set the properties of the link used by data sent from this connection.
+         * By default the link properties of the I/O handler are used.
+         * @param link Link properties.
+         * @see SimIOHandler::default_link
+         */
+        void link (const SimIOHandler::link_t& link);
+
+        /**
+         * Set the size of the send buffer.
+         * A write operation is only possible when there is room
+         * in the send buffer. Data leaves the send buffer when it
+         * is sent on the link, given the bandwidth of the link.
+         * @param size The size of the send buffer in bytes.
+         */
+        void send_buffer_size (size_t size);
+
+        /**
+         * Get the number of bytes received and not yet read.
+         * @return The number of bytes that can be read.
+         */
+        size_t available ();
+
+        /**
+         * Check if the connection is connected to a peer.
+         * @return <code>true</code> if connected.
+         */
+        bool is_connected ();
+
+        /**
+         * Return a handle identifying this connection in the I/O handler.
+         * This is not a file descriptor.
+         * @return A handle, or -1 if the connection is closed.
+         */
+        virtual int handle ();
+        virtual bool is_open () const;
+        virtual iohandler_base& io_handler ();
+        virtual void cancel (bool cancel_rx=true,
+                             bool cancel_tx=true,
+                             bool fast=false);
+
+        /**
+         * Close the connection.
+         * Pending I/O operations are cancelled. The peer reads end
+         * of file when all data already sent to it is received.
+         */
+        virtual void close ();
+
+        virtual ssize_t do_read (void* buf, size_t size, int& errnum);
+        virtual ssize_t do_write (const void* buf, size_t size, int& errnum);
+
+
+    private:
+        friend class SimIOHandler;
+
+        SimIOHandler& ioh;
+        std::atomic_int id;      // Handle, -1 when closed
+        int peer_id;             // Handle of peer, -1 if not connected
+        bool datagram;           // Message mode
+        bool eof;                // Peer is closed and all its data received
+        bool peer_closed;        // Peer is closed
+        SimIOHandler::link_t link_props;
+
+        // Receive side
+        std::list<std::string> rx_data; // Received data, one entry per write
+        size_t rx_pos;                  // Read position in the first entry (stream mode)
+        size_t rx_bytes;                // Bytes not yet read
+
+        // Send side
+        size_t sndbuf;         // Send buffer size
+        size_t tx_queued;      // Bytes in the send buffer
+        uint64_t link_free;    // Virtual time when the link is free to send
+        uint64_t last_arrival; // Virtual time when the last sent data arrives
+
+        // Called with the I/O handler mutex locked
+        bool rx_ready () const;
+        bool tx_ready () const;
+        void transmit (const char* data, size_t size);
+    };
+
+
+}
+#endif
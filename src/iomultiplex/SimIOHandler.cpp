@@ -0,0 +1,481 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/SimIOHandler.hpp>
+#include <iomultiplex/SimConnection.hpp>
+#include <cerrno>
+#include <climits>
+
+
+namespace iomultiplex {
+
+
+    constexpr SimIOHandler::link_t SimIOHandler::default_link_props;
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    SimIOHandler::SimIOHandler (uint64_t seed)
+        : clock {0},
+          quit {false},
+          running {false},
+          loop_tid {std::thread::id()},
+          event_seq {0},
+          op_seq {0},
+          next_handle {0},
+          def_link (default_link_props),
+          rng (seed),
+          loss_dist (0.0, 1.0),
+          stat_events {0},
+          stat_callbacks {0},
+          stat_bytes_sent {0},
+          stat_bytes_recv {0},
+          stat_lost {0}
+    {
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    SimIOHandler::~SimIOHandler ()
+    {
+        stop ();
+        join ();
+        std::lock_guard<std::mutex> lock (mutex);
+        ops_map.clear ();
+        timed_ops.clear ();
+        while (!events.empty())
+            events.pop ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SimIOHandler::run (bool start_worker_thread)
+    {
+        if (!start_worker_thread)
+            return loop (false, UINT64_MAX);
+
+        std::lock_guard<std::mutex> lock (mutex);
+        if (running || worker.joinable()) {
+            errno = EBUSY;
+            return -1;
+        }
+        quit = false;
+        running = true; // Set here so that a following run() fails
+        worker = std::thread ([this]{
+                {
+                    std::lock_guard<std::mutex> lock (mutex);
+                    running = false;
+                }
+                loop (true, UINT64_MAX);
+            });
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SimIOHandler::run_until (uint64_t time)
+    {
+        return loop (false, time);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SimIOHandler::run_once (int timeout)
+    {
+        uint64_t until;
+        uint64_t processed;
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            if (running) {
+                errno = EINPROGRESS;
+                return -1;
+            }
+            until = timeout<0 ? UINT64_MAX : clock + (uint64_t)timeout * 1000000ULL;
+            drop_dead_events ();
+            if (!events.empty() && events.top().time < until)
+                until = events.top().time;
+            else if (until == UINT64_MAX)
+                return 0; // Nothing will ever happen
+            processed = stat_events;
+        }
+
+        if (loop(false, until) < 0)
+            return -1;
+
+        std::lock_guard<std::mutex> lock (mutex);
+        return (int)(stat_events - processed);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SimIOHandler::loop (bool wait_when_idle, uint64_t until)
+    {
+        std::unique_lock<std::mutex> lock (mutex);
+        if (running) {
+            errno = EBUSY;
+            return -1;
+        }
+        running = true;
+        if (!wait_when_idle)
+            quit = false;
+        loop_tid = std::this_thread::get_id ();
+
+        while (!quit) {
+            drop_dead_events ();
+            if (events.empty() || events.top().time > until) {
+                if (!wait_when_idle)
+                    break;
+                cond.wait (lock);
+                continue;
+            }
+
+            // The event is moved out of the queue before it is popped
+            auto event = std::move (const_cast<event_t&>(events.top()));
+            events.pop ();
+            clock = event.time;
+            ++stat_events;
+
+            lock.unlock ();
+            event.fn ();
+            lock.lock ();
+        }
+
+        if (!quit && until != UINT64_MAX && clock < until)
+            clock = until;
+        loop_tid = std::thread::id ();
+        running = false;
+        errno = 0;
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SimIOHandler::stop ()
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        quit = true;
+        cond.notify_all ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    bool SimIOHandler::same_context () const
+    {
+        return loop_tid.load() == std::this_thread::get_id ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SimIOHandler::join ()
+    {
+        if (worker.joinable() && worker.get_id() != std::this_thread::get_id())
+            worker.join ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SimIOHandler::schedule (uint64_t delay, std::function<void ()> fn)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        post (clock + delay, fn);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SimIOHandler::default_link (const link_t& link)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        def_link = link;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    SimIOHandler::link_t SimIOHandler::default_link ()
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        return def_link;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SimIOHandler::stats (stats_t& stats)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        stats.events      = stat_events;
+        stats.callbacks   = stat_callbacks;
+        stats.bytes_sent  = stat_bytes_sent;
+        stats.bytes_recv  = stat_bytes_recv;
+        stats.lost        = stat_lost;
+        stats.connections = conns.size ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SimIOHandler::queue_io_op (Connection& conn,
+                                   void* buf,
+                                   size_t size,
+                                   io_callback_t cb,
+                                   const bool read,
+                                   const bool dummy_operation,
+                                   unsigned timeout)
+    {
+        auto handle = conn.handle ();
+        if (handle < 0) {
+            errno = EBADF;
+            return -1;
+        }
+
+        std::lock_guard<std::mutex> lock (mutex);
+        if (conns.find(handle) == conns.end()) {
+            errno = EINVAL; // Not a simulated connection
+            return -1;
+        }
+
+        auto ioop = std::make_shared<ioop_t> (conn, buf, size, cb, timeout,
+                                              dummy_operation, ++op_seq);
+        auto& ops = ops_map[handle];
+        (read ? ops.rx : ops.tx).emplace_back (ioop);
+
+        if (timeout != (unsigned)-1) {
+            timed_ops.insert (ioop->id);
+            post (clock + (uint64_t)timeout * 1000000,
+                  [this, handle, read, id=ioop->id]{
+                      expire (handle, read, id);
+                  },
+                  ioop->id);
+        }
+        kick (handle, read);
+
+        errno = 0;
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SimIOHandler::cancel (Connection& conn, bool rx, bool tx, bool fast)
+    {
+        auto handle = conn.handle ();
+        if (handle < 0 || (!rx && !tx))
+            return;
+
+        ioop_list_t cancelled;
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            auto entry = ops_map.find (handle);
+            if (entry == ops_map.end())
+                return;
+            if (rx)
+                cancelled.splice (cancelled.end(), entry->second.rx);
+            if (tx)
+                cancelled.splice (cancelled.end(), entry->second.tx);
+            if (entry->second.rx.empty() && entry->second.tx.empty())
+                ops_map.erase (entry);
+            for (auto& ioop : cancelled)
+                timed_ops.erase (ioop->id);
+        }
+        if (fast)
+            return;
+
+        // Called right away, while the connection is known to exist
+        for (auto& ioop : cancelled) {
+            if (ioop->cb) {
+                ioop->result = -1;
+                ioop->errnum = ECANCELED;
+                ioop->cb (*ioop);
+            }
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    // mutex is locked
+    //--------------------------------------------------------------------------
+    void SimIOHandler::post (uint64_t time, std::function<void ()> fn, uint64_t op_id)
+    {
+        events.push (event_t{time, ++event_seq, op_id, std::move(fn)});
+        cond.notify_one ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    // mutex is locked
+    // Remove timeouts of finished I/O operations from the front of
+    // the event queue, they must not advance the virtual clock.
+    //--------------------------------------------------------------------------
+    void SimIOHandler::drop_dead_events ()
+    {
+        while (!events.empty() &&
+               events.top().op_id &&
+               timed_ops.find(events.top().op_id) == timed_ops.end())
+        {
+            events.pop ();
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    // mutex is locked
+    //--------------------------------------------------------------------------
+    bool SimIOHandler::ready (int handle, bool read)
+    {
+        auto entry = conns.find (handle);
+        if (entry == conns.end())
+            return true; // Closed, let the operation fail
+        return read ? entry->second->rx_ready() : entry->second->tx_ready();
+    }
+
+
+    //--------------------------------------------------------------------------
+    // mutex is locked
+    // Schedule the I/O operations of a connection if it is ready.
+    //--------------------------------------------------------------------------
+    void SimIOHandler::kick (int handle, bool read)
+    {
+        auto entry = ops_map.find (handle);
+        if (entry == ops_map.end())
+            return;
+        auto& ops = entry->second;
+        auto& pending = read ? ops.rx_pending : ops.tx_pending;
+        if (pending || (read ? ops.rx : ops.tx).empty() || !ready(handle, read))
+            return;
+        pending = true;
+        post (clock, [this, handle, read]{
+                dispatch (handle, read);
+            });
+    }
+
+
+    //--------------------------------------------------------------------------
+    // mutex is locked
+    //--------------------------------------------------------------------------
+    bool SimIOHandler::lost (double probability)
+    {
+        return probability > 0.0 && loss_dist(rng) < probability;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // mutex is unlocked
+    // Perform queued I/O operations while the connection is ready.
+    //--------------------------------------------------------------------------
+    void SimIOHandler::dispatch (int handle, bool read)
+    {
+        std::unique_lock<std::mutex> lock (mutex);
+        auto entry = ops_map.find (handle);
+        if (entry == ops_map.end())
+            return;
+        (read ? entry->second.rx_pending : entry->second.tx_pending) = false;
+
+        while (!quit) {
+            entry = ops_map.find (handle);
+            if (entry == ops_map.end())
+                break;
+            auto& ops = read ? entry->second.rx : entry->second.tx;
+            if (ops.empty() || !ready(handle, read))
+                break;
+            auto ioop = ops.front ();
+            ops.pop_front ();
+            if (entry->second.rx.empty() && entry->second.tx.empty())
+                ops_map.erase (entry);
+            bool timed = timed_ops.erase (ioop->id) > 0;
+            lock.unlock ();
+
+            if (ioop->dummy_op) {
+                ioop->result = 0;
+                ioop->errnum = 0;
+            }
+            else if (read) {
+                ioop->result = ioop->conn.do_read (ioop->buf, ioop->size, ioop->errnum);
+            }else{
+                ioop->result = ioop->conn.do_write (ioop->buf, ioop->size, ioop->errnum);
+            }
+
+            if (ioop->result < 0 && ioop->errnum == EAGAIN) {
+                // Not ready after all, put it back first in the queue
+                lock.lock ();
+                auto& requeue = ops_map[handle];
+                (read ? requeue.rx : requeue.tx).push_front (ioop);
+                if (timed)
+                    timed_ops.insert (ioop->id);
+                break;
+            }
+            if (ioop->result >= 0)
+                ioop->errnum = 0;
+
+            // Like IOHandler_Epoll, don't continue with the next
+            // operation unless the callback returns true.
+            bool more = ioop->cb ? ioop->cb(*ioop) : false;
+            lock.lock ();
+            ++stat_callbacks;
+            if (!more) {
+                kick (handle, read);
+                break;
+            }
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    // mutex is unlocked
+    //--------------------------------------------------------------------------
+    void SimIOHandler::expire (int handle, bool read, uint64_t op_id)
+    {
+        std::shared_ptr<ioop_t> ioop;
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            auto entry = ops_map.find (handle);
+            if (entry == ops_map.end())
+                return;
+            auto& ops = read ? entry->second.rx : entry->second.tx;
+            for (auto i=ops.begin(); i!=ops.end(); ++i) {
+                if ((*i)->id == op_id) {
+                    ioop = *i;
+                    ops.erase (i);
+                    break;
+                }
+            }
+            if (!ioop)
+                return; // Already done
+            if (entry->second.rx.empty() && entry->second.tx.empty())
+                ops_map.erase (entry);
+            timed_ops.erase (op_id);
+            ++stat_callbacks;
+        }
+        if (ioop->cb) {
+            ioop->result = -1;
+            ioop->errnum = ETIMEDOUT;
+            ioop->cb (*ioop);
+        }
+    }
+
+
+}
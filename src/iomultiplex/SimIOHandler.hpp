@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_SIMIOHANDLER_HPP
+#define IOMULTIPLEX_SIMIOHANDLER_HPP
+
+#include <iomultiplex/iohandler_base.hpp>
+#include <iomultiplex/io_result_t.hpp>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <queue>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <cstdint>
+
+
+namespace iomultiplex {
+
+    // Forward declaration
+    class SimConnection;
+
+
+    /**
+     * An I/O handler for simulated connections using virtual time.
+     * Instead of waiting for real I/O events, the I/O handler runs
+     * a discrete event simulation. Data written to a SimConnection
+     * is delivered to its peer after a simulated delay, given by
+     * the latency, bandwidth, and packet loss of the link.
+     * When nothing happens, the virtual clock jumps directly to
+     * the next event. Hours of simulated time, and a very large
+     * number of connections, can then be run in seconds.
+     * This makes it possible to load test application protocols
+     * built on this library without real network hosts.
+     * <br/>
+     * Only SimConnection objects, and adapters using them, can be
+     * used with this I/O handler. Timeouts of I/O operations, and
+     * method <code>schedule</code>, use the virtual clock.
+     * Classes using a real clock, like TimerConnection, can't
+     * be used.
+     * <br/>
+     * All times are in nanoseconds of virtual time.
+     * @see SimConnection
+     */
+    class SimIOHandler : public iohandler_base {
+    public:
+        /**
+         * Properties of a simulated link.
+         */
+        struct link_t {
+            uint64_t latency;   /**< One way delay in nanoseconds. */
+            uint64_t bandwidth; /**< Bytes per second, 0 for unlimited bandwidth. */
+            double   loss;      /**< Probability, 0.0 - 1.0, that a write is lost. */
+            uint64_t rto;       /**< Retransmission delay in nanoseconds for stream connections. */
+        };
+
+        /**
+         * Simulation statistics.
+         */
+        struct stats_t {
+            uint64_t events;      /**< Simulation events processed. */
+            uint64_t callbacks;   /**< I/O callbacks called. */
+            uint64_t bytes_sent;  /**< Bytes written to simulated links. */
+            uint64_t bytes_recv;  /**< Bytes delivered to simulated connections. */
+            uint64_t lost;        /**< Lost writes, datagrams dropped or segments retransmitted. */
+            size_t   connections; /**< Open simulated connections. */
+        };
+
+        /**
+         * Default link, 1 ms latency, unlimited bandwidth, no loss,
+         * and a retransmission delay of 200 ms.
+         */
+        static constexpr link_t default_link_props {1000000, 0, 0.0, 200000000};
+
+        /**
+         * Constructor.
+         * @param seed Seed of the random generator used to simulate
+         *             packet loss. The same seed gives the same
+         *             simulation result.
+         */
+        SimIOHandler (uint64_t seed=1);
+
+        /**
+         * Destructor.
+         * Stops the simulation. Pending I/O operations
+         * are removed without calling their callbacks.
+         */
+        virtual ~SimIOHandler ();
+
+        /**
+         * Run the simulation.
+         * Without a worker thread, events are processed until method
+         * <code>stop</code> is called, or there are no more events.
+         * Since nothing can happen when there are no events, the
+         * simulation is then finished.
+         * <br/>
+         * With a worker thread, the worker waits for new I/O
+         * operations when there are no more events, until
+         * method <code>stop</code> is called.
+         * @param start_worker_thread If <code>true</code>, run the
+         *                            simulation in a worker thread
+         *                            and return immediately.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        virtual int run (bool start_worker_thread=false);
+
+        /**
+         * Run the simulation until a point in virtual time.
+         * Events up to, and including, <code>time</code> are processed,
+         * and then the virtual clock is set to <code>time</code>.
+         * @param time The virtual time in nanoseconds.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        int run_until (uint64_t time);
+
+        /**
+         * Run the simulation for a duration of virtual time.
+         * @param duration The duration in nanoseconds.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         */
+        int run_for (uint64_t duration) {
+            return run_until (now() + duration);
+        }
+
+        virtual void stop ();
+        virtual void cancel (Connection& conn,
+                             bool cancel_rx=true,
+                             bool cancel_tx=true,
+                             bool fast=false);
+        virtual bool same_context () const;
+        virtual void join ();
+
+        /**
+         * Process the events at the next point in virtual time.
+         * The virtual clock is advanced to the next scheduled event,
+         * and all events at that time are processed.
+         * @param timeout The maximum virtual time in milliseconds to
+         *                advance the clock. If -1, no limit is used.
+         * @return The number of events processed, or -1 on error
+         *         and <code>errno</code> is set.
+         */
+        virtual int run_once (int timeout=-1);
+
+        /**
+         * Get the virtual time.
+         * @return The number of nanoseconds since the simulation started.
+         */
+        uint64_t now () const {
+            return clock.load (std::memory_order_relaxed);
+        }
+
+        /**
+         * Call a function at a later point in virtual time.
+         * The function is called in the context of the I/O handler.
+         * @param delay The delay in nanoseconds.
+         * @param fn The function to call.
+         */
+        void schedule (uint64_t delay, std::function<void ()> fn);
+
+        /**
+         * Set the link properties used by new connections.
+         * @param link Link properties.
+         * @see SimConnection::link
+         */
+        void default_link (const link_t& link);
+
+        /**
+         * Get the link properties used by new connections.
+         * @return Link properties.
+         */
+        link_t default_link ();
+
+        /**
+         * Get simulation statistics.
+         * @param stats Where to store the statistics.
+         */
+        void stats (stats_t& stats);
+
+
+    protected:
+        virtual int queue_io_op (Connection& conn,
+                                 void* buf,
+                                 size_t size,
+                                 io_callback_t cb,
+                                 const bool read,
+                                 const bool dummy_operation,
+                                 unsigned timeout);
+
+
+    private:
+        friend class SimConnection;
+
+        // A single I/O operation
+        class ioop_t : public io_result_t {
+        public:
+            ioop_t (Connection& c, void* b, size_t s, io_callback_t callback,
+                    unsigned t, bool dummy, uint64_t op_id)
+                : io_result_t (c, b, s, 0, 0, t),
+                  cb {callback},
+                  dummy_op {dummy},
+                  id {op_id}
+                {
+                }
+            io_callback_t cb;
+            bool dummy_op;
+            uint64_t id;
+        };
+        using ioop_list_t = std::list<std::shared_ptr<ioop_t>>;
+
+        // All I/O operations of a simulated connection
+        struct ops_t {
+            ioop_list_t rx;
+            ioop_list_t tx;
+            bool rx_pending {false}; // Dispatch of read operations is scheduled
+            bool tx_pending {false}; // Dispatch of write operations is scheduled
+        };
+
+        // A simulation event
+        struct event_t {
+            uint64_t time;
+            uint64_t seq;
+            uint64_t op_id; // Timeout of this I/O operation, 0 if not a timeout
+            std::function<void ()> fn;
+        };
+        struct event_later_t {
+            bool operator() (const event_t& lhs, const event_t& rhs) const {
+                return lhs.time!=rhs.time ? lhs.time>rhs.time : lhs.seq>rhs.seq;
+            }
+        };
+
+        std::mutex mutex;             // Protects all simulation state, including connections
+        std::condition_variable cond; // Wakes up an idle worker thread
+        std::atomic<uint64_t> clock;  // Virtual time in nanoseconds
+        std::atomic_bool quit;
+        bool running;
+        std::thread worker;
+        std::atomic<std::thread::id> loop_tid; // Thread running the simulation
+
+        std::priority_queue<event_t, std::vector<event_t>, event_later_t> events;
+        uint64_t event_seq;
+        uint64_t op_seq;
+        int next_handle;
+
+        std::unordered_map<int, SimConnection*> conns; // Open connections
+        std::unordered_map<int, ops_t> ops_map;       // Queued I/O operations
+        std::unordered_set<uint64_t> timed_ops;       // Queued I/O operations with a timeout
+        link_t def_link;
+        std::mt19937_64 rng;
+        std::uniform_real_distribution<double> loss_dist;
+
+        uint64_t stat_events;
+        uint64_t stat_callbacks;
+        uint64_t stat_bytes_sent;
+        uint64_t stat_bytes_recv;
+        uint64_t stat_lost;
+
+        int loop (bool wait_when_idle, uint64_t until);
+
+        // Called with 'mutex' locked
+        void post (uint64_t time, std::function<void ()> fn, uint64_t op_id=0);
+        void drop_dead_events ();
+        bool ready (int handle, bool read);
+        void kick (int handle, bool read);
+        bool lost (double probability);
+
+        // Called with 'mutex' unlocked
+        void dispatch (int handle, bool read);
+        void expire (int handle, bool read, uint64_t op_id);
+    };
+
+
+}
+#endif
@@ -19,12 +19,25 @@
 #include <iomultiplex/SocketConnection.hpp>
 #include <iomultiplex/iohandler_base.hpp>
 #include <iomultiplex/Log.hpp>
+#include <iomultiplex/probes.hpp>
 #include <atomic>
+#include <mutex>
 #include <map>
+#include <deque>
+#include <utility>
 #include <cstring>
 #include <cerrno>
+#include <climits>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#include <poll.h>
 #include <netdb.h>
 
 
@@ -63,6 +76,37 @@ namespace iomultiplex {
     }
 
 
+    // Timestamping state, only allocated for sockets using timestamps
+    struct SocketConnection::tstamp_t {
+        std::atomic_bool rx {false}; // Receive timestamps enabled
+        std::atomic_bool tx {false}; // Transmit timestamps enabled
+        bool tx_key_bytes {false};   // Transmit timestamp keys count bytes, not messages
+        uint32_t tx_key {0};         // Key of the next transmit timestamp
+        std::mutex mutex;            // Protects tx_stamps
+        std::deque<std::pair<uint32_t, struct timespec>> tx_stamps; // Late transmit timestamps
+    };
+
+
+    //--------------------------------------------------------------------------
+    // Placeholder addresses are never modified, so one
+    // instance per address family is shared by all sockets.
+    //--------------------------------------------------------------------------
+    static std::shared_ptr<SockAddr> invalid_sockaddr (int family=AF_UNSPEC)
+    {
+        static std::mutex cache_mutex;
+        static std::map<int, std::shared_ptr<SockAddr>> cache;
+
+        std::lock_guard<std::mutex> lock (cache_mutex);
+        auto& addr = cache[family];
+        if (!addr) {
+            auto invalid_addr = std::make_shared<sc_invalid_sockaddr> ();
+            invalid_addr->family (family);
+            addr = invalid_addr;
+        }
+        return addr;
+    }
+
+
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
     const std::string sock_type_to_string (const int type)
@@ -181,12 +225,13 @@ namespace iomultiplex {
         : FdConnection   (io_handler),
           connected      {false},
           bound          {false},
+          exclusive_rx   {false},
           def_sock_rx_cb {nullptr},
           def_sock_tx_cb {nullptr}
     {
         TRACE ("Constructing a socket connection");
-        local_addr = std::make_shared<sc_invalid_sockaddr> ();
-        peer_addr  = std::make_shared<sc_invalid_sockaddr> ();
+        local_addr = invalid_sockaddr ();
+        peer_addr  = invalid_sockaddr ();
     }
 
 
@@ -196,6 +241,8 @@ namespace iomultiplex {
         : FdConnection   (std::move(rhs)),
           connected      {rhs.connected.exchange(false)},
           bound          {rhs.bound.exchange(false)},
+          exclusive_rx   {rhs.exclusive_rx.exchange(false)},
+          tstamp         {std::move(rhs.tstamp)},
           local_addr     {std::move(rhs.local_addr)},
           peer_addr      {std::move(rhs.peer_addr)},
           def_sock_rx_cb {std::move(rhs.def_sock_rx_cb)},
@@ -220,6 +267,8 @@ namespace iomultiplex {
             FdConnection::operator= (std::move(rhs));
             connected      = rhs.connected.exchange (false);
             bound          = rhs.bound.exchange (false);
+            exclusive_rx   = rhs.exclusive_rx.exchange (false);
+            tstamp         = std::move (rhs.tstamp);
             local_addr     = std::move (rhs.local_addr);
             peer_addr      = std::move (rhs.peer_addr);
             def_sock_rx_cb = std::move (rhs.def_sock_rx_cb);
@@ -251,7 +300,7 @@ namespace iomultiplex {
                 errno = errnum;
                 return -1;
             }
-            dynamic_cast<sc_invalid_sockaddr&>(*local_addr).family (domain);
+            local_addr = invalid_sockaddr (domain);
         }
         return 0;
     }
@@ -270,8 +319,9 @@ namespace iomultiplex {
         FdConnection::close ();
         connected = false;
         bound = false;
-        local_addr = std::make_shared<sc_invalid_sockaddr> ();
-        peer_addr  = std::make_shared<sc_invalid_sockaddr> ();
+        tstamp.reset ();
+        local_addr = invalid_sockaddr ();
+        peer_addr  = invalid_sockaddr ();
         TRACE ("Socket is closed");
     }
 
@@ -477,6 +527,8 @@ namespace iomultiplex {
             return -1;
         }
 
+        auto& sync = sync_state ();
+
         TRACE ("connecting a stream socket");
 
         bool io_done = false;
@@ -486,17 +538,17 @@ namespace iomultiplex {
 
         // Initiate connection
         if (connect(addr,
-                    [this, &errnum, &io_done](SocketConnection& conn, int err){
-                        std::unique_lock<std::mutex> lock (sync_mutex);
+                    [&errnum, &io_done, &sync](SocketConnection& conn, int err){
+                        std::unique_lock<std::mutex> lock (sync.mutex);
                         io_done = true;
                         errnum = err;
-                        sync_cond.notify_one ();
+                        sync.cond.notify_one ();
                     },
                     timeout) == 0)
         {
             // Wait for connection to finish or timeout
-            std::unique_lock<std::mutex> lock (sync_mutex);
-            sync_cond.wait (lock, [&io_done]{return io_done;});
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&io_done]{return io_done;});
             if (!errnum)
                 retval = 0;
             errno = errnum;
@@ -559,8 +611,8 @@ namespace iomultiplex {
 
         // Wait until we have incoming data before we make the
         // call to accept().
-        wait_for_rx ([this, callback](io_result_t& ior)->bool{
-                handle_accept_result (callback, ior.errnum);
+        wait_for_rx ([this, callback, timeout](io_result_t& ior)->bool{
+                handle_accept_result (callback, ior.errnum, timeout);
                 return false;
             }, timeout);
         return 0;
@@ -569,7 +621,32 @@ namespace iomultiplex {
 
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
-    void SocketConnection::handle_accept_result (accept_cb_t cb, int errnum)
+    std::shared_ptr<SocketConnection> SocketConnection::share_listener (iohandler_base& io_handler)
+    {
+        if (handle() < 0) {
+            errno = EBADF;
+            return nullptr;
+        }
+
+        int new_fd = fcntl (handle(), F_DUPFD_CLOEXEC, 0);
+        if (new_fd < 0)
+            return nullptr;
+
+        auto sock = std::make_shared<SocketConnection> (io_handler);
+        sock->fd = new_fd;
+        sock->bound = bound.load ();
+        sock->local_addr = local_addr->clone ();
+        sock->exclusive_rx = true;
+        exclusive_rx = true;
+
+        TRACE ("Socket %d shared as socket %d", handle(), new_fd);
+        return sock;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SocketConnection::handle_accept_result (accept_cb_t cb, int errnum, unsigned timeout)
     {
         if (!cb)
             return;
@@ -586,6 +663,14 @@ namespace iomultiplex {
                                      &slen,
                                      SOCK_NONBLOCK);
             errnum = result<0 ? errno : 0;
+            IOM_PROBE3 (accept, handle(), result, errnum);
+            if (errnum==EAGAIN && exclusive_rx) {
+                // Another I/O handler sharing this socket
+                // accepted the connection, wait for the next one.
+                if (accept(cb, timeout) == 0)
+                    return;
+                errnum = errno;
+            }
             client_sock->fd = result;
             if (client_sock->handle() >= 0) {
                 client_sock->connected  = true;
@@ -618,22 +703,24 @@ namespace iomultiplex {
             errno = EDEADLK;
             return client;
         }
+
+        auto& sync = sync_state ();
         errno = 0;
 
         // Start accepting connections
-        if (accept([this, &errnum, &io_done, &client](SocketConnection& s, std::shared_ptr<SocketConnection> c, int err){
-                    std::unique_lock<std::mutex> lock (sync_mutex);
+        if (accept([&errnum, &io_done, &client, &sync](SocketConnection& s, std::shared_ptr<SocketConnection> c, int err){
+                    std::unique_lock<std::mutex> lock (sync.mutex);
                     io_done = true;
                     errnum = err;
                     if (!errnum)
                         client = c;
-                    sync_cond.notify_one ();
+                    sync.cond.notify_one ();
                 },
                 timeout) == 0)
         {
             // Wait for a new connection or timeout
-            std::unique_lock<std::mutex> lock (sync_mutex);
-            sync_cond.wait (lock, [&io_done]{return io_done;});
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&io_done]{return io_done;});
             errno = errnum;
         }
         return client;
@@ -655,16 +742,19 @@ namespace iomultiplex {
         return wait_for_rx ([this, buf, size, rx_cb](io_result_t& ior)->bool{
                 auto peer = local_addr->clone ();
                 peer->clear ();
-                if (ior.errnum == 0) {
-                    ior.result = do_recvfrom (buf, size, 0, *peer);
-                    ior.errnum = ior.result<0 ? errno : 0;
+                sock_io_result_t res (ior.conn,
+                                      buf,
+                                      size,
+                                      ior.result,
+                                      ior.errnum,
+                                      ior.timeout);
+                if (res.errnum == 0) {
+                    if (tstamp && tstamp->rx)
+                        res.result = recv_timestamped (buf, size, *peer, res);
+                    else
+                        res.result = do_recvfrom (buf, size, 0, *peer);
+                    res.errnum = res.result<0 ? errno : 0;
                 }
-                io_result_t res (ior.conn,
-                                 buf,
-                                 size,
-                                 ior.result,
-                                 ior.errnum,
-                                 ior.timeout);
                 if (rx_cb)
                     rx_cb (*this, res, *peer);
                 else if (def_sock_rx_cb)
@@ -691,28 +781,30 @@ namespace iomultiplex {
             errno = EDEADLK;
             return peer;
         }
+
+        auto& sync = sync_state ();
         errno = 0;
 
         // Queue a read operation
         if (recvfrom(buf,
                      (size_t)size,
-                     [this, &size, &io_done, &errnum, &peer](SocketConnection& sock,
+                     [&size, &io_done, &errnum, &peer, &sync](SocketConnection& sock,
                                                              io_result_t& ior,
                                                              const SockAddr& pa)
                      {
-                         std::unique_lock<std::mutex> lock (sync_mutex);
+                         std::unique_lock<std::mutex> lock (sync.mutex);
                          io_done = true;
                          errnum = ior.errnum;
                          size = ior.result;
                          if (!errnum)
                              peer = pa.clone();
-                         sync_cond.notify_one ();
+                         sync.cond.notify_one ();
                      },
                      timeout) == 0)
         {
             // Wait for read operation to finish or timeout
-            std::unique_lock<std::mutex> lock (sync_mutex);
-            sync_cond.wait (lock, [&io_done]{return io_done;});
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&io_done]{return io_done;});
             errno = errnum;
         }else{
             size = -1;
@@ -743,6 +835,7 @@ namespace iomultiplex {
         errno = 0;
         return wait_for_tx ([this, buf, size, addr=peer.clone(), tx_cb](io_result_t& ior)->bool{
                 ssize_t result = do_sendto (buf, size, 0, *addr);
+                int errnum = result<0 ? errno : 0;
                 if (result>=0 && local_addr->size()==0) {
                     // Update local address if not bound to one
                     local_addr = addr->clone ();
@@ -750,12 +843,22 @@ namespace iomultiplex {
                     if (getsockname(handle(), const_cast<struct sockaddr*>(local_addr->data()), &slen))
                         local_addr->clear ();
                 }
-                io_result_t res (ior.conn,
-                                 const_cast<void*>(buf),
-                                 size,
-                                 result,
-                                 errno<0 ? errno : 0,
-                                 ior.timeout);
+                sock_io_result_t res (ior.conn,
+                                      const_cast<void*>(buf),
+                                      size,
+                                      result,
+                                      errnum,
+                                      ior.timeout);
+                if (result>=0 && tstamp && tstamp->tx) {
+                    if (tstamp->tx_key_bytes) {
+                        res.ts_key = tstamp->tx_key + (uint32_t)result - 1;
+                        tstamp->tx_key += (uint32_t) result;
+                    }else{
+                        res.ts_key = tstamp->tx_key++;
+                    }
+                    // Software timestamps are normally taken before sendto() returns
+                    res.has_timestamp = read_error_queue(res.ts_key, res.timestamp) == 1;
+                }
                 if (tx_cb)
                     tx_cb (*this, res, *addr);
                 else if (def_sock_tx_cb)
@@ -776,6 +879,7 @@ namespace iomultiplex {
             errno = EDEADLK;
             return -1;
         }
+        auto& sync = sync_state ();
         ssize_t result = -1;
         bool io_done = false;
         int errnum = 0;
@@ -785,21 +889,21 @@ namespace iomultiplex {
         if (sendto(buf,
                    size,
                    peer,
-                   [this, &result, &io_done, &errnum](SocketConnection& sock,
+                   [&result, &io_done, &errnum, &sync](SocketConnection& sock,
                                                       io_result_t& ior,
                                                       const SockAddr& peer)
                    {
-                       std::unique_lock<std::mutex> lock (sync_mutex);
+                       std::unique_lock<std::mutex> lock (sync.mutex);
                        result = ior.result;
                        errnum = ior.errnum;
                        io_done = true;
-                       sync_cond.notify_one ();
+                       sync.cond.notify_one ();
                    },
                    timeout) == 0)
         {
             // Wait for the write operation to finish or timeout
-            std::unique_lock<std::mutex> lock (sync_mutex);
-            sync_cond.wait (lock, [&io_done]{return io_done;});
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&io_done]{return io_done;});
             errno = errnum;
         }
         return result;
@@ -865,6 +969,206 @@ namespace iomultiplex {
     }
 
 
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SocketConnection::rx_low_watermark (size_t bytes)
+    {
+        int value = bytes>INT_MAX ? INT_MAX : (bytes ? (int)bytes : 1);
+        return setsockopt (SO_RCVLOWAT, value);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SocketConnection::tx_low_watermark (size_t bytes)
+    {
+        int value = bytes>INT_MAX ? INT_MAX : (int)bytes;
+        return setsockopt (IPPROTO_TCP, TCP_NOTSENT_LOWAT, value);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    ssize_t SocketConnection::unsent_bytes ()
+    {
+        int value = 0;
+        if (ioctl(handle(), SIOCOUTQNSD, &value) < 0)
+            return -1;
+        return value;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SocketConnection::timestamping (bool rx, bool tx)
+    {
+        int flags = 0;
+        if (rx)
+            flags |= SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if (tx) {
+            flags |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+        }
+        if (setsockopt(SO_TIMESTAMPING, flags))
+            return -1;
+
+        if (!tstamp)
+            tstamp = std::make_unique<tstamp_t> ();
+
+        // The kernel restarts the keys at 0 only when
+        // SOF_TIMESTAMPING_OPT_ID wasn't already set
+        if (tx && !tstamp->tx) {
+            tstamp->tx_key_bytes = getsockopt(SO_TYPE) == SOCK_STREAM;
+            tstamp->tx_key = 0;
+            std::lock_guard<std::mutex> lock (tstamp->mutex);
+            tstamp->tx_stamps.clear ();
+        }
+        tstamp->rx = rx;
+        tstamp->tx = tx;
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    bool SocketConnection::tx_timestamp (uint32_t& key, struct timespec& ts)
+    {
+        if (!tstamp)
+            return false;
+        if (tstamp->tx)
+            read_error_queue (-1, ts);
+
+        std::lock_guard<std::mutex> lock (tstamp->mutex);
+        if (tstamp->tx_stamps.empty())
+            return false;
+        key = tstamp->tx_stamps.front().first;
+        ts  = tstamp->tx_stamps.front().second;
+        tstamp->tx_stamps.pop_front ();
+        return true;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    bool SocketConnection::handle_error_queue ()
+    {
+        if (!tstamp || !tstamp->tx)
+            return false;
+
+        struct timespec ts;
+        if (read_error_queue(-1, ts) < 0)
+            return false;
+
+        // Check if there is an error condition left, like a socket error
+        struct pollfd pfd;
+        pfd.fd = handle ();
+        pfd.events = 0;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 0) < 0)
+            return false;
+        return (pfd.revents & POLLERR) == 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Read all transmit timestamps in the socket error queue.
+    // Return 1 if the timestamp with the given key was found,
+    // -1 if a message that isn't a timestamp was read, otherwise 0.
+    // Other timestamps are saved for method tx_timestamp().
+    //--------------------------------------------------------------------------
+    int SocketConnection::read_error_queue (int64_t key, struct timespec& ts)
+    {
+        static constexpr size_t max_saved_stamps = 64;
+        int retval = 0;
+
+        while (true) {
+            char control[256];
+            struct msghdr msg;
+            memset (&msg, 0, sizeof(msg));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof (control);
+
+            if (recvmsg(handle(), &msg, MSG_ERRQUEUE|MSG_DONTWAIT) < 0)
+                break; // Error queue empty, or a socket error
+
+            struct timespec stamp {0, 0};
+            bool have_stamp = false;
+            bool have_key = false;
+            uint32_t stamp_key = 0;
+            for (auto* cmsg=CMSG_FIRSTHDR(&msg); cmsg; cmsg=CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPING) {
+                    struct scm_timestamping tss;
+                    memcpy (&tss, CMSG_DATA(cmsg), sizeof(tss));
+                    stamp = tss.ts[0]; // Software timestamp
+                    have_stamp = true;
+                }
+                else if ((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                         (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+                {
+                    struct sock_extended_err ee;
+                    memcpy (&ee, CMSG_DATA(cmsg), sizeof(ee));
+                    if (ee.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                        stamp_key = ee.ee_data;
+                        have_key = true;
+                    }else{
+                        retval = -1; // Not a timestamp, an ICMP error or similar
+                    }
+                }
+            }
+            if (!have_stamp || !have_key)
+                continue;
+
+            if (key >= 0 && stamp_key == (uint32_t)key) {
+                ts = stamp;
+                if (retval == 0)
+                    retval = 1;
+            }else{
+                std::lock_guard<std::mutex> lock (tstamp->mutex);
+                if (tstamp->tx_stamps.size() >= max_saved_stamps)
+                    tstamp->tx_stamps.pop_front ();
+                tstamp->tx_stamps.emplace_back (stamp_key, stamp);
+            }
+        }
+        return retval;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Receive a message, and a receive timestamp if available
+    //--------------------------------------------------------------------------
+    ssize_t SocketConnection::recv_timestamped (void* buf, size_t len,
+                                                SockAddr& peer,
+                                                sock_io_result_t& res)
+    {
+        char control[256];
+        struct iovec iov;
+        struct msghdr msg;
+        iov.iov_base = buf;
+        iov.iov_len = len;
+        memset (&msg, 0, sizeof(msg));
+        msg.msg_name = const_cast<sockaddr*> (peer.data());
+        msg.msg_namelen = addr().size ();
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof (control);
+
+        auto result = recvmsg (handle(), &msg, 0);
+        if (result < 0)
+            return result;
+
+        for (auto* cmsg=CMSG_FIRSTHDR(&msg); cmsg; cmsg=CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPING) {
+                struct scm_timestamping tss;
+                memcpy (&tss, CMSG_DATA(cmsg), sizeof(tss));
+                res.timestamp = tss.ts[0]; // Software timestamp
+                res.has_timestamp = res.timestamp.tv_sec || res.timestamp.tv_nsec;
+            }
+        }
+        return result;
+    }
+
+
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
     int SocketConnection::setsockopt (int optname, const int value)
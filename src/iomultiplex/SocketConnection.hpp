@@ -25,6 +25,8 @@
 #include <functional>
 #include <atomic>
 #include <memory>
+#include <cstdint>
+#include <ctime>
 
 
 namespace iomultiplex {
@@ -42,6 +44,30 @@ namespace iomultiplex {
     int sock_proto_by_name (const std::string& protocol);
 
 
+    /**
+     * Result of a socket I/O operation, with a kernel timestamp.
+     * The callbacks of methods <code>recvfrom</code> and
+     * <code>sendto</code> in class SocketConnection get an
+     * io_result_t object of this type.
+     * @see SocketConnection::timestamping
+     */
+    class sock_io_result_t : public io_result_t {
+    public:
+        bool has_timestamp;        /**< <code>true</code> if <code>timestamp</code> is valid. */
+        struct timespec timestamp; /**< Kernel software timestamp (CLOCK_REALTIME) of when the
+                                    *   data was received, or handed to the network device. */
+        uint32_t ts_key;           /**< Timestamp key of sent data, see SocketConnection::tx_timestamp. */
+
+        sock_io_result_t (Connection& c, void* b, size_t s, ssize_t r, int e, unsigned t)
+            : io_result_t (c, b, s, r, e, t),
+              has_timestamp {false},
+              timestamp {0, 0},
+              ts_key {0}
+            {
+            }
+    };
+
+
     /**
      * A TCP/IP network socket connection.
      */
@@ -180,6 +206,122 @@ namespace iomultiplex {
          */
         std::shared_ptr<SocketConnection> accept (unsigned timeout=-1);
 
+        /**
+         * Share a listening socket with another I/O handler.
+         * Creates a new socket connection, managed by another
+         * I/O handler, that refers to the same listening socket
+         * (using a duplicated file descriptor). Both this socket
+         * and the new one are set to use exclusive wakeup, so when
+         * several I/O handlers wait to accept on the same socket,
+         * only one of them is woken up per incoming connection.
+         * <br/>
+         * This is useful when the application must use a single
+         * listening socket, for example one inherited from systemd,
+         * and <code>SO_REUSEPORT</code> can't be used.
+         * @param io_handler The I/O handler managing the new connection.
+         * @return A new socket connection, or <code>nullptr</code>
+         *         on failure and <code>errno</code> is set.
+         * @see exclusive_wakeup
+         */
+        std::shared_ptr<SocketConnection> share_listener (iohandler_base& io_handler);
+
+        /**
+         * Set or clear exclusive wakeup for this socket.
+         * When set, only one of several I/O handlers waiting
+         * for incoming data (or connections) on the socket is
+         * woken up. Only read operations can be queued on a
+         * socket using exclusive wakeup, and the setting must not
+         * be changed while I/O operations are queued.
+         * Requires an I/O handler using <code>EPOLLEXCLUSIVE</code>,
+         * other I/O handlers ignore this setting.
+         * @param exclusive <code>true</code> to use exclusive wakeup.
+         */
+        void exclusive_wakeup (bool exclusive) {
+            exclusive_rx = exclusive;
+        }
+
+        virtual bool exclusive_wakeup () const {
+            return exclusive_rx;
+        }
+
+        /**
+         * Set the minimum number of bytes needed to report the socket readable.
+         * This sets socket option <code>SO_RCVLOWAT</code>.
+         * @param bytes The minimum number of bytes. 1 is the default.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        virtual int rx_low_watermark (size_t bytes);
+
+        /**
+         * Limit the amount of unsent data in the kernel send buffer.
+         * This sets the TCP socket option <code>TCP_NOTSENT_LOWAT</code>.
+         * When set, the socket is only writable when there are less
+         * than <code>bytes</code> bytes of unsent data in the kernel,
+         * and a large write operation only writes part of its
+         * buffer. The write callback is then called with the number
+         * of bytes actually written, and the application queues the
+         * rest when it should produce more data.
+         * <br/>
+         * Write operations queued in the meantime, for example
+         * urgent control messages, are then written before the rest
+         * of the bulk data instead of waiting behind megabytes of
+         * data in the kernel send buffer.
+         * @param bytes The maximum number of unsent bytes in the
+         *              kernel. 0 restores the system default.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         * @see unsent_bytes
+         */
+        int tx_low_watermark (size_t bytes);
+
+        /**
+         * Get the number of bytes in the kernel send buffer not yet sent.
+         * @return The number of unsent bytes, or -1 on failure
+         *         and <code>errno</code> is set.
+         */
+        ssize_t unsent_bytes ();
+
+        /**
+         * Enable kernel software timestamps (<code>SO_TIMESTAMPING</code>).
+         * With receive timestamps enabled, the callbacks of method
+         * <code>recvfrom</code> get the time when the kernel
+         * received the data. With transmit timestamps enabled, the
+         * callbacks of method <code>sendto</code> get the time when
+         * the data was handed to the network device driver.
+         * The timestamps are found in the sock_io_result_t object
+         * passed to the callbacks.
+         * <br/>
+         * Transmit timestamps are delivered by the kernel in the
+         * socket error queue. If a timestamp isn't available
+         * when the send operation is done, it is saved and can be
+         * read later using method <code>tx_timestamp</code>.
+         * <br/>
+         * Call this method before queueing any I/O operations
+         * on the socket. Timestamping is turned off when the
+         * socket is closed.
+         * @param rx <code>true</code> to enable receive timestamps.
+         * @param tx <code>true</code> to enable transmit timestamps.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         * @see sock_io_result_t
+         */
+        int timestamping (bool rx, bool tx);
+
+        /**
+         * Get a transmit timestamp that wasn't available when
+         * the send operation was done.
+         * For datagram sockets, the key is the number of datagrams
+         * sent before the timestamped one since transmit timestamps
+         * were enabled. For stream sockets, it is the offset of
+         * the last byte of the send operation.
+         * At most the 64 latest timestamps are saved.
+         * @param key The key of the timestamped data.
+         * @param ts The timestamp.
+         * @return <code>true</code> if a timestamp was found,
+         *         <code>false</code> if there are no more saved timestamps.
+         */
+        bool tx_timestamp (uint32_t& key, struct timespec& ts);
+
+        virtual bool handle_error_queue ();
+
         /**
          * Get the local address.
          * @return The local address.
@@ -357,10 +499,15 @@ namespace iomultiplex {
         SocketConnection& operator= (const SocketConnection& conn) = delete;
 
         int connect_using_datagram (const SockAddr& addr);
-        void handle_accept_result (accept_cb_t cb, int errnum);
+        void handle_accept_result (accept_cb_t cb, int errnum, unsigned timeout);
+        ssize_t recv_timestamped (void* buf, size_t len, SockAddr& peer, sock_io_result_t& res);
+        int read_error_queue (int64_t key, struct timespec& ts);
 
         std::atomic_bool connected;            // Connected to a peer
         std::atomic_bool bound;                // Bound to a local address
+        std::atomic_bool exclusive_rx;         // Exclusive wakeup on RX
+        struct tstamp_t;
+        std::unique_ptr<tstamp_t> tstamp;      // Timestamping state, nullptr until timestamping() is called
         std::shared_ptr<SockAddr> local_addr;  // Local address
         std::shared_ptr<SockAddr> peer_addr;   // Address of peer
 
@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/SpliceProxy.hpp>
+#include <iomultiplex/iohandler_base.hpp>
+#include <iomultiplex/utils.hpp>
+#include <iomultiplex/Log.hpp>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+
+namespace iomultiplex {
+
+#define THIS_FILE "SpliceProxy"
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    SpliceProxy::direction_t::direction_t (FdConnection& source, FdConnection& destination)
+        : src {source},
+          dst {destination},
+          pipe {make_pipe(source.io_handler(), O_CLOEXEC)},
+          in_pipe {0},
+          eof {false},
+          done {false},
+          bytes {0}
+    {
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    SpliceProxy::SpliceProxy (FdConnection& a, FdConnection& b, size_t pipe_size)
+        : a2b {a, b},
+          b2a {b, a},
+          pipe_sz {0},
+          running {false}
+    {
+        if (!a2b.pipe.first.is_open() || !b2a.pipe.first.is_open())
+            throw std::system_error (errno, std::generic_category(), "make_pipe");
+
+        if (pipe_size) {
+            // Failing to resize the pipes isn't fatal, we get the default size
+            if (fcntl(a2b.pipe.second.handle(), F_SETPIPE_SZ, (int)pipe_size) < 0 ||
+                fcntl(b2a.pipe.second.handle(), F_SETPIPE_SZ, (int)pipe_size) < 0)
+            {
+                Log::info (THIS_FILE " - Unable to set pipe size to %lu: %s",
+                           pipe_size, strerror(errno));
+            }
+        }
+        int sz_a = fcntl (a2b.pipe.second.handle(), F_GETPIPE_SZ);
+        int sz_b = fcntl (b2a.pipe.second.handle(), F_GETPIPE_SZ);
+        pipe_sz = (size_t) (sz_a < sz_b ? sz_a : sz_b);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    SpliceProxy::~SpliceProxy ()
+    {
+        if (running) {
+            running = false;
+            a2b.src.cancel (true, true, true);
+            b2a.src.cancel (true, true, true);
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int SpliceProxy::start (done_cb_t callback)
+    {
+        if (running) {
+            errno = EINPROGRESS;
+            return -1;
+        }
+        if (!a2b.src.is_open() || !b2a.src.is_open()) {
+            errno = EBADF;
+            return -1;
+        }
+
+        for (auto* dir : {&a2b, &b2a}) {
+            // Discard any leftover data from a previous run
+            char buf[4096];
+            while (dir->in_pipe) {
+                ssize_t result = ::read (dir->pipe.first.handle(), buf,
+                                         dir->in_pipe < sizeof(buf) ? dir->in_pipe : sizeof(buf));
+                if (result <= 0)
+                    break;
+                dir->in_pipe -= (size_t) result;
+            }
+            dir->in_pipe = 0;
+            dir->eof = false;
+            dir->done = false;
+            dir->bytes = 0;
+        }
+        done_cb = callback;
+        running = true;
+
+        for (auto* dir : {&a2b, &b2a}) {
+            if (dir->src.wait_for_rx([this, dir](io_result_t& ior)->bool{
+                        if (ior.result < 0)
+                            finish (ior.errnum);
+                        else
+                            pump (*dir);
+                        return false;
+                    }))
+            {
+                int errnum = errno;
+                stop ();
+                errno = errnum;
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SpliceProxy::stop ()
+    {
+        if (running) {
+            a2b.src.cancel ();
+            b2a.src.cancel ();
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    bool SpliceProxy::is_running () const
+    {
+        return running;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    uint64_t SpliceProxy::a_to_b_bytes () const
+    {
+        return a2b.bytes;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    uint64_t SpliceProxy::b_to_a_bytes () const
+    {
+        return b2a.bytes;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    size_t SpliceProxy::pipe_size () const
+    {
+        return pipe_sz;
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Called in I/O handler context
+    //--------------------------------------------------------------------------
+    void SpliceProxy::pump (direction_t& dir)
+    {
+        auto io_cb = [this, &dir](io_result_t& ior)->bool{
+            if (ior.result < 0)
+                finish (ior.errnum);
+            else
+                pump (dir);
+            // Always return false, the next
+            // wait operation is queued by pump()
+            return false;
+        };
+
+        while (running) {
+            bool src_empty = false;
+
+            // Move data from the source to the pipe
+            if (!dir.eof && dir.in_pipe < pipe_sz) {
+                ssize_t result = splice (dir.src.handle(), nullptr,
+                                         dir.pipe.second.handle(), nullptr,
+                                         pipe_sz - dir.in_pipe,
+                                         SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (result > 0) {
+                    dir.in_pipe += (size_t) result;
+                }
+                else if (result == 0) {
+                    dir.eof = true;
+                }
+                else if (errno == EAGAIN) {
+                    src_empty = true;
+                }
+                else if (errno != EINTR) {
+                    finish (errno);
+                    return;
+                }
+            }
+
+            // Move data from the pipe to the destination
+            if (dir.in_pipe) {
+                ssize_t result = splice (dir.pipe.first.handle(), nullptr,
+                                         dir.dst.handle(), nullptr,
+                                         dir.in_pipe,
+                                         SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (result > 0) {
+                    dir.in_pipe -= (size_t) result;
+                    dir.bytes += (uint64_t) result;
+                    continue;
+                }
+                else if (result < 0 && errno == EAGAIN) {
+                    // Destination is full, wait until it is writable
+                    if (dir.dst.wait_for_tx(io_cb))
+                        finish (errno);
+                    return;
+                }
+                else if (result < 0 && errno != EINTR) {
+                    finish (errno);
+                    return;
+                }
+                continue;
+            }
+
+            if (dir.eof) {
+                // All data flushed, propagate the half-close
+                if (::shutdown(dir.dst.handle(), SHUT_WR) && errno != ENOTSOCK && errno != ENOTCONN)
+                    Log::debug (THIS_FILE " - shutdown failed: %s", strerror(errno));
+                dir.done = true;
+                if (a2b.done && b2a.done)
+                    finish (0);
+                return;
+            }
+
+            if (src_empty) {
+                // Wait for more data from the source
+                if (dir.src.wait_for_rx(io_cb))
+                    finish (errno);
+                return;
+            }
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void SpliceProxy::finish (int errnum)
+    {
+        std::unique_lock<std::mutex> lock (done_mutex);
+        if (!running)
+            return;
+        running = false;
+
+        // Remove the remaining operation in the other direction
+        a2b.src.cancel (true, true, true);
+        b2a.src.cancel (true, true, true);
+
+        auto cb = done_cb;
+        lock.unlock ();
+        if (cb)
+            cb (*this, errnum);
+    }
+
+
+}
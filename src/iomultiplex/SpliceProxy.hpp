@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_SPLICEPROXY_HPP
+#define IOMULTIPLEX_SPLICEPROXY_HPP
+
+#include <iomultiplex/FdConnection.hpp>
+#include <functional>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+
+namespace iomultiplex {
+
+
+    /**
+     * Bidirectional zero-copy proxy between two connections.
+     * Data is moved between the file descriptors of the two
+     * connections using <code>splice()</code> through an
+     * internal pipe for each direction, without copying the
+     * data to user space.
+     * <br/>
+     * When one side reaches end-of-file, the remaining data
+     * in the pipe is flushed to the other side, and the write
+     * direction of that side is shut down (if it is a socket).
+     * The proxy is finished when both directions have reached
+     * end-of-file, or when an error occurs in either direction.
+     * \note Both connections must have file descriptors that
+     *       support <code>splice()</code>, like stream sockets,
+     *       pipes, and regular files. Both connections must use
+     *       the same I/O handler. Adapters, like TlsAdapter, can't
+     *       be used since the data would bypass them.
+     * \note While the proxy is running, it owns the I/O
+     *       operations of both connections. Don't queue other
+     *       read or write operations on them.
+     */
+    class SpliceProxy {
+    public:
+        /**
+         * Callback called when the proxy is finished.
+         * It is called in the context of the I/O handler.
+         * @param proxy The proxy object.
+         * @param errnum 0 if both directions reached end-of-file,
+         *               <code>ECANCELED</code> if the proxy was
+         *               stopped, otherwise an error code.
+         */
+        using done_cb_t = std::function<void (SpliceProxy& proxy, int errnum)>;
+
+        static constexpr size_t default_pipe_size {65536}; /**< Default size of the internal pipes. */
+
+        /**
+         * Constructor.
+         * @param a One endpoint of the proxy.
+         * @param b The other endpoint of the proxy.
+         * @param pipe_size The requested size of each internal pipe.
+         *                  The kernel may round it up, and unprivileged
+         *                  processes are limited by
+         *                  <code>/proc/sys/fs/pipe-max-size</code>.
+         * @throw std::system_error If the internal pipes can't be created.
+         */
+        SpliceProxy (FdConnection& a, FdConnection& b, size_t pipe_size=default_pipe_size);
+
+        /**
+         * Destructor.
+         * If the proxy is running, all I/O operations on both
+         * connections are removed without calling the done callback.
+         */
+        ~SpliceProxy ();
+
+        /**
+         * Start moving data between the two connections.
+         * @param done_cb Called when the proxy is finished.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int start (done_cb_t done_cb=nullptr);
+
+        /**
+         * Stop the proxy.
+         * All I/O operations on both connections are cancelled.
+         * Data still in the internal pipes is discarded.
+         */
+        void stop ();
+
+        /**
+         * Check if the proxy is running.
+         * @return <code>true</code> if the proxy is running.
+         */
+        bool is_running () const;
+
+        /**
+         * Return the number of bytes moved from connection <code>a</code>
+         * to connection <code>b</code>.
+         * @return The number of bytes written to <code>b</code>.
+         */
+        uint64_t a_to_b_bytes () const;
+
+        /**
+         * Return the number of bytes moved from connection <code>b</code>
+         * to connection <code>a</code>.
+         * @return The number of bytes written to <code>a</code>.
+         */
+        uint64_t b_to_a_bytes () const;
+
+        /**
+         * Return the actual size of the internal pipes.
+         * @return The size in bytes of each internal pipe.
+         */
+        size_t pipe_size () const;
+
+
+    private:
+        SpliceProxy () = delete;
+        SpliceProxy (const SpliceProxy& proxy) = delete;
+        SpliceProxy (SpliceProxy&& proxy) = delete;
+        SpliceProxy& operator= (const SpliceProxy& proxy) = delete;
+        SpliceProxy& operator= (SpliceProxy&& proxy) = delete;
+
+        struct direction_t {
+            direction_t (FdConnection& source, FdConnection& destination);
+            FdConnection& src;
+            FdConnection& dst;
+            std::pair<FdConnection, FdConnection> pipe;
+            size_t in_pipe;
+            bool eof;
+            bool done;
+            std::atomic<uint64_t> bytes;
+        };
+
+        void pump (direction_t& dir);
+        void finish (int errnum);
+
+        direction_t a2b;
+        direction_t b2a;
+        size_t pipe_sz;
+        std::atomic_bool running;
+        std::mutex done_mutex;
+        done_cb_t done_cb;
+    };
+
+
+}
+#endif
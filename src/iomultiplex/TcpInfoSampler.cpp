@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/TcpInfoSampler.hpp>
+#include <vector>
+#include <tuple>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <linux/tcp.h>
+
+
+namespace iomultiplex {
+
+
+    static constexpr size_t min_read_size {16 * 1024};
+    static constexpr size_t max_read_size {1024 * 1024};
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    TcpInfoSampler::TcpInfoSampler (iohandler_base& ioh, unsigned interval_ms)
+        : timer (ioh, CLOCK_BOOTTIME),
+          interval {interval_ms ? interval_ms : default_interval},
+          min_buf {default_min_buf},
+          max_buf {default_max_buf}
+    {
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    TcpInfoSampler::~TcpInfoSampler ()
+    {
+        timer.close ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int TcpInfoSampler::sample_now (SocketConnection& sock, sample_t& sample)
+    {
+        struct tcp_info ti;
+        socklen_t len = sizeof (ti);
+        memset (&ti, 0, sizeof(ti));
+        if (sock.getsockopt(IPPROTO_TCP, TCP_INFO, &ti, &len))
+            return -1;
+
+        sample.rtt           = ti.tcpi_rtt;
+        sample.rtt_var       = ti.tcpi_rttvar;
+        sample.min_rtt       = ti.tcpi_min_rtt;
+        sample.snd_cwnd      = ti.tcpi_snd_cwnd;
+        sample.snd_mss       = ti.tcpi_snd_mss;
+        sample.total_retrans = ti.tcpi_total_retrans;
+        sample.delivery_rate = ti.tcpi_delivery_rate;
+        sample.rcv_rtt       = ti.tcpi_rcv_rtt;
+        sample.rcv_space     = ti.tcpi_rcv_space;
+
+        // Estimate the bandwidth-delay product from the delivery rate
+        // and the minimum RTT, but never less than what fits in the
+        // current congestion window.
+        uint32_t rtt = sample.min_rtt ? sample.min_rtt : sample.rtt;
+        uint64_t bdp = sample.delivery_rate * rtt / 1000000;
+        sample.bdp = std::max (bdp, (uint64_t)sample.snd_cwnd * sample.snd_mss);
+
+        sample.sndbuf = sock.getsockopt (SO_SNDBUF);
+        sample.rcvbuf = sock.getsockopt (SO_RCVBUF);
+
+        size_t read_size = std::min (std::max((size_t)sample.bdp, min_read_size), max_read_size);
+        sample.read_size = (read_size + 4095) & ~(size_t)4095;
+
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int TcpInfoSampler::add (SocketConnection& sock, unsigned tune, sample_cb_t callback)
+    {
+        sample_t sample;
+        if (sample_now(sock, sample))
+            return -1;
+
+        std::lock_guard<std::mutex> lock (mutex);
+        auto& entry = entries[&sock];
+        entry.tune = tune;
+        entry.last = sample;
+        entry.cb = callback;
+
+        if (entries.size() == 1) {
+            // Start the timer
+            if (timer.set(interval, interval, [this](){tick();})) {
+                int errnum = errno;
+                entries.erase (&sock);
+                errno = errnum;
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void TcpInfoSampler::remove (SocketConnection& sock)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        entries.erase (&sock);
+        if (entries.empty())
+            timer.cancel ();
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int TcpInfoSampler::sample (SocketConnection& sock, sample_t& sample) const
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        auto entry = entries.find (&sock);
+        if (entry == entries.end()) {
+            errno = ENOENT;
+            return -1;
+        }
+        sample = entry->second.last;
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void TcpInfoSampler::buffer_limits (size_t min_buf_size, size_t max_buf_size)
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        min_buf = min_buf_size;
+        max_buf = std::max (min_buf_size, max_buf_size);
+    }
+
+
+    //--------------------------------------------------------------------------
+    // mutex is locked
+    //--------------------------------------------------------------------------
+    void TcpInfoSampler::tune_buffers (SocketConnection& sock, unsigned tune, sample_t& sample)
+    {
+        // Room for two BDPs, so the pipe is kept full while the
+        // application is refilling (or draining) the buffer.
+        auto target_of = [this](uint64_t bdp)->int {
+            return (int) std::min (std::max((size_t)bdp * 2, min_buf), max_buf);
+        };
+
+        // Setting a buffer size locks it, the kernel stops autotuning
+        // it. Only grow a buffer, never below what the kernel has
+        // already tuned it to. The kernel doubles the requested size
+        // for bookkeeping overhead, and reports the doubled size.
+        auto needs_resize = [](int current, int target)->bool {
+            int usable = current / 2;
+            return usable < target - target/4;
+        };
+
+        if (tune & tune_sndbuf) {
+            // The sender side BDP
+            int target = target_of (sample.bdp);
+            if (needs_resize(sample.sndbuf, target) &&
+                sock.setsockopt(SO_SNDBUF, target) == 0)
+            {
+                sample.sndbuf = sock.getsockopt (SO_SNDBUF);
+            }
+        }
+        if ((tune & tune_rcvbuf) && sample.rcv_rtt) {
+            // The sender side metrics stay at their initial values on
+            // a connection that mostly receives. Use the receiver's
+            // estimate of bytes received per round-trip time instead.
+            int target = target_of (sample.rcv_space);
+            if (needs_resize(sample.rcvbuf, target) &&
+                sock.setsockopt(SO_RCVBUF, target) == 0)
+            {
+                sample.rcvbuf = sock.getsockopt (SO_RCVBUF);
+            }
+        }
+    }
+
+
+    //--------------------------------------------------------------------------
+    // Called in I/O handler context
+    //--------------------------------------------------------------------------
+    void TcpInfoSampler::tick ()
+    {
+        std::vector<std::tuple<SocketConnection*, sample_t, sample_cb_t>> samples;
+
+        std::unique_lock<std::mutex> lock (mutex);
+        for (auto& e : entries) {
+            auto& entry = e.second;
+            sample_t sample;
+            if (sample_now(*e.first, sample))
+                continue; // Not a TCP socket, or closed
+            if (entry.tune != tune_none)
+                tune_buffers (*e.first, entry.tune, sample);
+            entry.last = sample;
+            if (entry.cb)
+                samples.emplace_back (e.first, sample, entry.cb);
+        }
+        lock.unlock ();
+
+        for (auto& s : samples)
+            std::get<2>(s) (*this, *std::get<0>(s), std::get<1>(s));
+    }
+
+
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_TCPINFOSAMPLER_HPP
+#define IOMULTIPLEX_TCPINFOSAMPLER_HPP
+
+#include <iomultiplex/iohandler_base.hpp>
+#include <iomultiplex/SocketConnection.hpp>
+#include <iomultiplex/TimerConnection.hpp>
+#include <functional>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+
+namespace iomultiplex {
+
+
+    /**
+     * Periodic sampling of TCP connection state, with optional buffer tuning.
+     * At a coarse interval, socket option <code>TCP_INFO</code> is read
+     * for each added TCP connection. From the round-trip time and
+     * delivery rate the bandwidth-delay product (BDP) is estimated,
+     * and if tuning is enabled, the socket send buffer is resized to
+     * fit it. The receive buffer is sized from the receiver's own
+     * estimate, the number of bytes received per receive round-trip
+     * time. Buffers are only ever grown, never set below the size
+     * the kernel has already tuned them to.
+     * <br/>
+     * The latest sample of each connection is available with
+     * method <code>sample</code>, and a callback can be called
+     * for each new sample.
+     */
+    class TcpInfoSampler {
+    public:
+        /**
+         * A sample of the state of a TCP connection.
+         */
+        struct sample_t {
+            uint32_t rtt;           /**< Smoothed round-trip time in microseconds. */
+            uint32_t rtt_var;       /**< Round-trip time variance in microseconds. */
+            uint32_t min_rtt;       /**< Minimum round-trip time in microseconds. */
+            uint32_t snd_cwnd;      /**< Congestion window in segments. */
+            uint32_t snd_mss;       /**< Sender maximum segment size. */
+            uint32_t total_retrans; /**< Total number of retransmitted segments. */
+            uint64_t delivery_rate; /**< Delivery rate in bytes per second. */
+            uint64_t bdp;           /**< Estimated bandwidth-delay product in bytes. */
+            uint32_t rcv_rtt;       /**< Receiver side round-trip time estimate in microseconds. */
+            uint32_t rcv_space;     /**< Bytes received per receive round-trip time. */
+            int sndbuf;             /**< Current SO_SNDBUF size in bytes. */
+            int rcvbuf;             /**< Current SO_RCVBUF size in bytes. */
+            size_t read_size;       /**< Suggested read size in bytes. */
+        };
+
+        /**
+         * Callback called for each new sample of a connection.
+         * Called in the context of the I/O handler.
+         * @param sampler The TcpInfoSampler object.
+         * @param sock The sampled connection.
+         * @param sample The new sample.
+         */
+        using sample_cb_t = std::function<void (TcpInfoSampler& sampler,
+                                                SocketConnection& sock,
+                                                const sample_t& sample)>;
+
+        static constexpr unsigned tune_none   {0}; /**< Only sample, don't resize buffers. */
+        static constexpr unsigned tune_sndbuf {1}; /**< Resize the socket send buffer. */
+        static constexpr unsigned tune_rcvbuf {2}; /**< Resize the socket receive buffer. */
+
+        static constexpr unsigned default_interval {1000}; /**< Default sample interval in milliseconds. */
+        static constexpr size_t default_min_buf {64 * 1024};        /**< Default minimum tuned buffer size. */
+        static constexpr size_t default_max_buf {64 * 1024 * 1024}; /**< Default maximum tuned buffer size. */
+
+        /**
+         * Constructor.
+         * @param ioh The I/O handler running the sample timer.
+         * @param interval The sample interval in milliseconds.
+         * @throw std::system_error If the timer can't be created.
+         */
+        TcpInfoSampler (iohandler_base& ioh, unsigned interval=default_interval);
+
+        /**
+         * Destructor.
+         * Stops sampling. Buffer sizes are left as they are.
+         */
+        ~TcpInfoSampler ();
+
+        /**
+         * Add, or update, a TCP connection to sample.
+         * @param sock A connected TCP socket.
+         * @param tune A bitmask of <code>tune_sndbuf</code> and
+         *             <code>tune_rcvbuf</code>, or <code>tune_none</code>.
+         *             <br/><b>Note:</b> Setting a buffer size turns off
+         *             the kernel's own automatic tuning of that buffer
+         *             for the socket, permanently. To not make things
+         *             worse, a buffer is only set when the target is
+         *             larger than the current, possibly autotuned, size.
+         *             The receive buffer isn't touched until the kernel
+         *             has a receive round-trip time estimate.
+         * @param callback If not <code>nullptr</code>, this
+         *                 is called for each new sample.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        int add (SocketConnection& sock, unsigned tune=tune_none, sample_cb_t callback=nullptr);
+
+        /**
+         * Stop sampling a connection.
+         * @param sock The connection to remove.
+         */
+        void remove (SocketConnection& sock);
+
+        /**
+         * Get the latest sample of a connection.
+         * @param sock A connection previously added.
+         * @param sample Where to store the sample.
+         * @return 0 on success, -1 if the connection isn't
+         *         added and <code>errno</code> is set to <code>ENOENT</code>.
+         */
+        int sample (SocketConnection& sock, sample_t& sample) const;
+
+        /**
+         * Set the limits of tuned buffer sizes.
+         * @param min_buf The minimum buffer size in bytes.
+         * @param max_buf The maximum buffer size in bytes.
+         */
+        void buffer_limits (size_t min_buf, size_t max_buf);
+
+        /**
+         * Sample a TCP connection directly.
+         * @param sock A connected TCP socket.
+         * @param sample Where to store the sample.
+         * @return 0 on success, -1 on failure and <code>errno</code> is set.
+         */
+        static int sample_now (SocketConnection& sock, sample_t& sample);
+
+
+    private:
+        TcpInfoSampler () = delete;
+        TcpInfoSampler (const TcpInfoSampler& s) = delete;
+        TcpInfoSampler& operator= (const TcpInfoSampler& s) = delete;
+
+        struct entry_t {
+            unsigned tune;
+            sample_t last;
+            sample_cb_t cb;
+        };
+
+        void tick ();
+        void tune_buffers (SocketConnection& sock, unsigned tune, sample_t& sample);
+
+        TimerConnection timer;
+        const unsigned interval;
+        size_t min_buf;
+        size_t max_buf;
+        mutable std::mutex mutex;
+        std::unordered_map<SocketConnection*, entry_t> entries;
+    };
+
+
+}
+#endif
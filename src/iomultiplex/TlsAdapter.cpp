@@ -19,8 +19,10 @@
 #include <iomultiplex/TlsAdapter.hpp>
 #include <iomultiplex/iohandler_base.hpp>
 #include <iomultiplex/Log.hpp>
+#include <iomultiplex/probes.hpp>
 #include <cstring>
 #include <cerrno>
+#include <atomic>
 #include <openssl/err.h>
 
 
@@ -42,6 +44,50 @@
 namespace iomultiplex {
 
 
+    // TLS handshake statistics
+    static std::atomic<uint64_t> stat_handshakes_started {0};
+    static std::atomic<uint64_t> stat_handshakes_succeeded {0};
+    static std::atomic<uint64_t> stat_handshakes_failed {0};
+    static std::atomic<uint64_t> stat_handshake_time {0};
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void TlsAdapter::handshake_stats (handshake_stats_t& stats)
+    {
+        stats.started    = stat_handshakes_started;
+        stats.succeeded  = stat_handshakes_succeeded;
+        stats.failed     = stat_handshakes_failed;
+        stats.total_time = stat_handshake_time;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void TlsAdapter::handshake_begin ()
+    {
+        clock_gettime (CLOCK_MONOTONIC, &handshake_start);
+        ++stat_handshakes_started;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    void TlsAdapter::handshake_end (bool success)
+    {
+        struct timespec now;
+        clock_gettime (CLOCK_MONOTONIC, &now);
+        int64_t usec = (int64_t)(now.tv_sec - handshake_start.tv_sec) * 1000000 +
+                       (now.tv_nsec - handshake_start.tv_nsec) / 1000;
+        stat_handshake_time += usec>0 ? (uint64_t)usec : 0;
+        IOM_PROBE3 (tls_handshake, handle(), success, usec);
+        if (success)
+            ++stat_handshakes_succeeded;
+        else
+            ++stat_handshakes_failed;
+    }
+
+
     //--------------------------------------------------------------------------
     //--------------------------------------------------------------------------
     TlsAdapter::TlsAdapter (Connection& conn, bool close_on_destruct)
@@ -348,6 +394,7 @@ namespace iomultiplex {
         }
 
         clear_error ();
+        handshake_begin ();
 
         TRACE ("Starting TLS %s handshake on file handle %d",
                (is_server ? "server" : "client"), handle());
@@ -358,6 +405,7 @@ namespace iomultiplex {
             tls_ctx     = nullptr;
             tls_active  = false;
             tls_started = false;
+            handshake_end (false);
             TRACE ("File handle %d failed to configure TLS", handle());
             errno = EINVAL;
             return -1;
@@ -374,6 +422,7 @@ namespace iomultiplex {
             tls_ctx     = nullptr;
             tls_active  = false;
             tls_started = false;
+            handshake_end (false);
             errno       = EINVAL;
             return -1;
         }
@@ -423,6 +472,7 @@ namespace iomultiplex {
             tls_ctx     = nullptr;
             tls_active  = false;
             tls_started = false;
+            handshake_end (false);
         }
 
         return result;
@@ -444,6 +494,7 @@ namespace iomultiplex {
             errno = EDEADLK;
             return -1;
         }
+        auto& sync = sync_state ();
         bool io_done = false;
         int errnum = 0;
         int retval = -1;
@@ -453,17 +504,17 @@ namespace iomultiplex {
                       use_dtls,
                       buf,
                       buf_len,
-                      [this, &errnum, &io_done](Connection& conn){
-                          std::unique_lock<std::mutex> lock (sync_mutex);
+                      [this, &errnum, &io_done, &sync](Connection& conn){
+                          std::unique_lock<std::mutex> lock (sync.mutex);
                           io_done = true;
                           errnum = last_error ();
-                          sync_cond.notify_one ();
+                          sync.cond.notify_one ();
                       },
                       timeout) == 0)
         {
             // Wait for TLS handshake to finish, fail, or timeout
-            std::unique_lock<std::mutex> lock (sync_mutex);
-            sync_cond.wait (lock, [&io_done]{return io_done;});
+            std::unique_lock<std::mutex> lock (sync.mutex);
+            sync.cond.wait (lock, [&io_done]{return io_done;});
             if (errnum) {
                 cancel ();
                 if (tls)
@@ -532,6 +583,7 @@ namespace iomultiplex {
             mem_bio_buf.reset ();
             TRACE ("TLS handshake success for file handle %d after only initial RX buffer data", handle());
             tls_active = true;
+            handshake_end (true);
             if (cb) {
                 retval = wait_for_tx ([this, cb](io_result_t& ior)->bool {
                                           cb (*this);
@@ -654,6 +706,7 @@ namespace iomultiplex {
             TRACE ("TLS handshake success for file handle %d", handle());
             tls_active = true;
         }
+        handshake_end (errnum == 0);
 
         if (cb)
             cb (*this);
@@ -28,6 +28,8 @@
 #include <vector>
 #include <atomic>
 #include <memory>
+#include <cstdint>
+#include <ctime>
 #include <openssl/ssl.h>
 
 
@@ -106,6 +108,22 @@ namespace iomultiplex {
          */
         std::string last_error_msg () const;
 
+        /**
+         * TLS handshake statistics for all TLS adapters.
+         */
+        struct handshake_stats_t {
+            uint64_t started;    /**< Number of started TLS handshakes. */
+            uint64_t succeeded;  /**< Number of successful TLS handshakes. */
+            uint64_t failed;     /**< Number of failed TLS handshakes. */
+            uint64_t total_time; /**< Total time of all finished TLS handshakes in microseconds. */
+        };
+
+        /**
+         * Get TLS handshake statistics for all TLS adapters.
+         * @param stats Where to store the statistics.
+         */
+        static void handshake_stats (handshake_stats_t& stats);
+
         /**
          * Get the certificate of the peer (if any).
          * @return The certificate of the peer (if any).
@@ -479,6 +497,8 @@ namespace iomultiplex {
                                    int errnum);
         void clear_error ();
         void update_error (const char* msg=nullptr);
+        void handshake_begin ();
+        void handshake_end (bool success);
 
         SSL_CTX* tls_ctx; // OpenSSL context object
         SSL* tls;         // OpenSSL SSL(TLS) object
@@ -489,6 +509,7 @@ namespace iomultiplex {
         std::unique_ptr<char> mem_bio_buf;
         std::atomic_bool tls_started; // TLS handshake started
         std::atomic_bool tls_active;  // TLS handshake done and TLS active
+        struct timespec handshake_start; // Time when the TLS handshake started
     };
 
 
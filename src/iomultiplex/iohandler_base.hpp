@@ -22,6 +22,7 @@
 #include <iomultiplex/types.hpp>
 #include <iomultiplex/Connection.hpp>
 #include <iomultiplex/PollDescriptors.hpp>
+#include <iomultiplex/RateLimiter.hpp>
 #include <functional>
 #include <memory>
 #include <atomic>
@@ -32,6 +33,7 @@
 #include <map>
 #include <set>
 #include <ctime>
+#include <cerrno>
 #include <signal.h>
 #include <sys/types.h>
 #include <poll.h>
@@ -190,6 +192,18 @@ namespace iomultiplex {
                              bool cancel_tx=true,
                              bool fast=false) = 0;
 
+        /**
+         * Forget all settings the I/O handler has for a connection,
+         * like its rate limits and latency histograms.
+         * This is called by the connection when it is closed or
+         * destroyed, so that a new connection object created at the
+         * same address doesn't get the settings of the old one.
+         * @param conn The connection to forget.
+         */
+        virtual void forget (Connection& conn) {
+            (void) conn;
+        }
+
         /**
          * Check if the I/O handler is running in the same
          * context(i.e. same thread) as the caller.
@@ -210,6 +224,102 @@ namespace iomultiplex {
          */
         virtual void join () = 0;
 
+        /**
+         * Handle one batch of I/O events and expired timeouts, then return.
+         * Instead of letting method <code>run()</code> handle I/O until
+         * stopped, this method can be called repeatedly from an
+         * application's own loop. The calling thread is the context
+         * of the I/O handler during the call.
+         * \note This method can't be used while the I/O handler
+         *       is running by method <code>run()</code>.
+         * @param timeout The maximum time in milliseconds to wait
+         *                for I/O events. If -1, wait until there
+         *                is an I/O event or a timeout expires.
+         *                The method may return earlier if
+         *                interrupted by another thread.
+         * @return The number of I/O events and timeouts handled,
+         *         or -1 on error and <code>errno</code> is set.
+         *         <code>EINPROGRESS</code> if the I/O handler is
+         *         already running, <code>ENOTSUP</code> if the
+         *         I/O handler doesn't support this method.
+         * @see iohandler_base::poll
+         */
+        virtual int run_once (int timeout=-1) {
+            (void) timeout;
+            errno = ENOTSUP;
+            return -1;
+        }
+
+        /**
+         * Handle I/O events and expired timeouts without waiting.
+         * Same as calling <code>run_once(0)</code>.
+         * @return The number of I/O events and timeouts handled,
+         *         or -1 on error and <code>errno</code> is set.
+         * @see iohandler_base::run_once
+         */
+        int poll () {
+            return run_once (0);
+        }
+
+        /**
+         * Limit the rate of all I/O operations handled by the I/O handler.
+         * When an I/O operation exceeds the limit, it is deferred, and
+         * the file descriptor isn't polled in that direction until the
+         * limiter allows more data. On stream sockets, and other
+         * non-socket file descriptors, read and write operations
+         * transfer at most as many bytes as the limiter allows at the
+         * moment, the result of an operation is therefore more often
+         * a partial read or write. On message based sockets, like
+         * SOCK_DGRAM and SOCK_SEQPACKET, an operation is never made
+         * smaller, it is deferred until the limiter allows all of it.
+         * <br/>The limits of the I/O handler apply in addition to any
+         * limits set for a specific connection.
+         * @param rx_limiter The limiter for read operations,
+         *                   <code>nullptr</code> for no limit.
+         * @param tx_limiter The limiter for write operations,
+         *                   <code>nullptr</code> for no limit.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         *         <code>ENOTSUP</code> if the I/O handler doesn't
+         *         support rate limiting.
+         */
+        virtual int rate_limit (std::shared_ptr<RateLimiter> rx_limiter,
+                                std::shared_ptr<RateLimiter> tx_limiter)
+        {
+            (void) rx_limiter;
+            (void) tx_limiter;
+            errno = ENOTSUP;
+            return -1;
+        }
+
+        /**
+         * Limit the rate of the I/O operations of a connection.
+         * Use a limiter with a parent to share a limit between
+         * connections, for example all connections of a tenant.
+         * Call this method with <code>nullptr</code> limiters to
+         * remove the limits. The limits are also removed when the
+         * connection is closed, and must be set again if the
+         * connection is reopened.
+         * @param conn The connection used when queueing the I/O operations.
+         * @param rx_limiter The limiter for read operations,
+         *                   <code>nullptr</code> for no limit.
+         * @param tx_limiter The limiter for write operations,
+         *                   <code>nullptr</code> for no limit.
+         * @return 0 on success, -1 on error and <code>errno</code> is set.
+         *         <code>ENOTSUP</code> if the I/O handler doesn't
+         *         support rate limiting.
+         * @see RateLimiter
+         */
+        virtual int rate_limit (Connection& conn,
+                                std::shared_ptr<RateLimiter> rx_limiter,
+                                std::shared_ptr<RateLimiter> tx_limiter)
+        {
+            (void) conn;
+            (void) rx_limiter;
+            (void) tx_limiter;
+            errno = ENOTSUP;
+            return -1;
+        }
+
 
     protected:
         /**
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_PROBES_HPP
+#define IOMULTIPLEX_PROBES_HPP
+
+//
+// USDT (statically defined tracing) probes used internally by libiomultiplex.
+// This file is not installed.
+//
+// When built with sys/sdt.h available, each probe is a single nop
+// instruction until a tracer (bpftrace, perf, systemtap) is attached.
+// All probes are in provider "iomultiplex", for example:
+//
+//   bpftrace -e 'usdt:/usr/lib/libiomultiplex.so:iomultiplex:op_queued { @[arg1] = count(); }'
+//
+// Probes and arguments:
+//   op_queued     (fd, read, size, timeout, op)  An I/O operation is queued.
+//   op_done       (fd, read, result, errnum, op) An I/O operation callback is called.
+//   op_timeout    (fd, read, op)                 An I/O operation timed out.
+//   cancel        (fd, rx, tx, fast)             I/O operations are cancelled.
+//   epoll_wakeup  (num_events)                   epoll_pwait() returned.
+//   accept        (listen_fd, fd, errnum)        A connection is accepted.
+//   tls_handshake (fd, success, usec)            A TLS handshake is finished.
+//
+// Argument 'op' is an opaque pointer identifying the I/O operation,
+// the latency of an operation is the time between op_queued and op_done
+// with the same 'op' value.
+//
+#ifdef HAVE_USDT
+
+#include <sys/sdt.h>
+
+#define IOM_PROBE1(name, a1) \
+    DTRACE_PROBE1(iomultiplex, name, a1)
+#define IOM_PROBE3(name, a1, a2, a3) \
+    DTRACE_PROBE3(iomultiplex, name, a1, a2, a3)
+#define IOM_PROBE4(name, a1, a2, a3, a4) \
+    DTRACE_PROBE4(iomultiplex, name, a1, a2, a3, a4)
+#define IOM_PROBE5(name, a1, a2, a3, a4, a5) \
+    DTRACE_PROBE5(iomultiplex, name, a1, a2, a3, a4, a5)
+
+#else
+
+#define IOM_PROBE1(name, a1) do{}while(false)
+#define IOM_PROBE3(name, a1, a2, a3) do{}while(false)
+#define IOM_PROBE4(name, a1, a2, a3, a4) do{}while(false)
+#define IOM_PROBE5(name, a1, a2, a3, a4, a5) do{}while(false)
+
+#endif
+
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <iomultiplex/termios2.hpp>
+#include <cerrno>
+#include <asm/termbits.h>
+#include <asm/ioctls.h>
+#include <sys/ioctl.h>
+
+
+namespace iomultiplex {
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int termios2_set_speed (int fd, int baud_rate)
+    {
+#if defined(TCGETS2) && defined(BOTHER)
+        if (baud_rate <= 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        struct termios2 tio;
+        if (ioctl(fd, TCGETS2, &tio))
+            return -1;
+
+        tio.c_cflag &= ~CBAUD;
+        tio.c_cflag |= BOTHER;
+#  ifdef IBSHIFT
+        tio.c_cflag &= ~(CBAUD << IBSHIFT);
+        tio.c_cflag |= BOTHER << IBSHIFT;
+#  endif
+        tio.c_ispeed = (speed_t) baud_rate;
+        tio.c_ospeed = (speed_t) baud_rate;
+
+        return ioctl (fd, TCSETS2, &tio);
+#else
+        errno = ENOTSUP;
+        return -1;
+#endif
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int termios2_get_speed (int fd)
+    {
+#if defined(TCGETS2)
+        struct termios2 tio;
+        if (ioctl(fd, TCGETS2, &tio))
+            return -1;
+        return (int) tio.c_ospeed;
+#else
+        errno = ENOTSUP;
+        return -1;
+#endif
+    }
+
+
+}
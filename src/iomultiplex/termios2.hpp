@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2026 Dan Arrhenius <dan@ultramarin.se>
+ *
+ * This file is part of libiomultiplex
+ *
+ * libiomultiplex is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IOMULTIPLEX_TERMIOS2_HPP
+#define IOMULTIPLEX_TERMIOS2_HPP
+
+//
+// Internal helpers for setting arbitrary baud rates.
+// The kernel's struct termios2 can't be used in the same translation
+// unit as <termios.h>, so this header must not include any of them.
+//
+
+namespace iomultiplex {
+
+    /**
+     * Set a custom baud rate using <code>termios2</code> and <code>BOTHER</code>.
+     * @param fd An open terminal file descriptor.
+     * @param baud_rate The baud rate used for both input and output.
+     * @return 0 on success, -1 on error and <code>errno</code> is set.
+     */
+    int termios2_set_speed (int fd, int baud_rate);
+
+    /**
+     * Get the baud rate using <code>termios2</code>.
+     * @param fd An open terminal file descriptor.
+     * @return The output baud rate, or -1 on error and <code>errno</code> is set.
+     */
+    int termios2_get_speed (int fd);
+
+}
+#endif
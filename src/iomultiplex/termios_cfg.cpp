@@ -64,6 +64,54 @@ namespace iomultiplex {
             return B115200;
         case 230400:
             return B230400;
+#ifdef B460800
+        case 460800:
+            return B460800;
+#endif
+#ifdef B500000
+        case 500000:
+            return B500000;
+#endif
+#ifdef B576000
+        case 576000:
+            return B576000;
+#endif
+#ifdef B921600
+        case 921600:
+            return B921600;
+#endif
+#ifdef B1000000
+        case 1000000:
+            return B1000000;
+#endif
+#ifdef B1152000
+        case 1152000:
+            return B1152000;
+#endif
+#ifdef B1500000
+        case 1500000:
+            return B1500000;
+#endif
+#ifdef B2000000
+        case 2000000:
+            return B2000000;
+#endif
+#ifdef B2500000
+        case 2500000:
+            return B2500000;
+#endif
+#ifdef B3000000
+        case 3000000:
+            return B3000000;
+#endif
+#ifdef B3500000
+        case 3500000:
+            return B3500000;
+#endif
+#ifdef B4000000
+        case 4000000:
+            return B4000000;
+#endif
         default:
             return 0;
         }
@@ -111,6 +159,54 @@ namespace iomultiplex {
             return 115200;
         case B230400:
             return 230400;
+#ifdef B460800
+        case B460800:
+            return 460800;
+#endif
+#ifdef B500000
+        case B500000:
+            return 500000;
+#endif
+#ifdef B576000
+        case B576000:
+            return 576000;
+#endif
+#ifdef B921600
+        case B921600:
+            return 921600;
+#endif
+#ifdef B1000000
+        case B1000000:
+            return 1000000;
+#endif
+#ifdef B1152000
+        case B1152000:
+            return 1152000;
+#endif
+#ifdef B1500000
+        case B1500000:
+            return 1500000;
+#endif
+#ifdef B2000000
+        case B2000000:
+            return 2000000;
+#endif
+#ifdef B2500000
+        case B2500000:
+            return 2500000;
+#endif
+#ifdef B3000000
+        case B3000000:
+            return 3000000;
+#endif
+#ifdef B3500000
+        case B3500000:
+            return 3500000;
+#endif
+#ifdef B4000000
+        case B4000000:
+            return 4000000;
+#endif
         default:
             return 0;
         }
@@ -145,7 +241,12 @@ namespace iomultiplex {
     //--------------------------------------------------------------------------
     int termios_cfg::ispeed (int baud)
     {
-        return cfsetispeed (this, baud_to_speed(baud));
+        speed_t s = baud_to_speed (baud);
+        if (s==0 && baud!=0) {
+            errno = EINVAL; // Not a standard baud rate
+            return -1;
+        }
+        return cfsetispeed (this, s);
     }
 
 
@@ -161,7 +262,12 @@ namespace iomultiplex {
     //--------------------------------------------------------------------------
     int termios_cfg::ospeed (int baud)
     {
-        return cfsetospeed (this, baud_to_speed(baud));
+        speed_t s = baud_to_speed (baud);
+        if (s==0 && baud!=0) {
+            errno = EINVAL; // Not a standard baud rate
+            return -1;
+        }
+        return cfsetospeed (this, s);
     }
 
 
@@ -177,7 +283,20 @@ namespace iomultiplex {
     //--------------------------------------------------------------------------
     int termios_cfg::speed (int baud)
     {
-        return cfsetspeed (this, baud_to_speed(baud));
+        speed_t s = baud_to_speed (baud);
+        if (s==0 && baud!=0) {
+            errno = EINVAL; // Not a standard baud rate
+            return -1;
+        }
+        return cfsetspeed (this, s);
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    bool termios_cfg::is_standard_speed (int baud)
+    {
+        return baud==0 || baud_to_speed(baud)!=0;
     }
 
 
@@ -360,4 +479,46 @@ namespace iomultiplex {
     }
 
 
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    unsigned termios_cfg::vmin ()
+    {
+        return c_cc[VMIN];
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int termios_cfg::vmin (unsigned num_bytes)
+    {
+        if (num_bytes > 255) {
+            errno = EINVAL;
+            return -1;
+        }
+        c_cc[VMIN] = (cc_t) num_bytes;
+        return 0;
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    unsigned termios_cfg::vtime ()
+    {
+        return c_cc[VTIME];
+    }
+
+
+    //--------------------------------------------------------------------------
+    //--------------------------------------------------------------------------
+    int termios_cfg::vtime (unsigned deciseconds)
+    {
+        if (deciseconds > 255) {
+            errno = EINVAL;
+            return -1;
+        }
+        c_cc[VTIME] = (cc_t) deciseconds;
+        return 0;
+    }
+
+
 }
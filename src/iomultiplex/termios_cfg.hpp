@@ -67,6 +67,8 @@ namespace iomultiplex {
          * Set the input baud rate.
          * @param rate The input baud rate.
          * @return 0 on success. -1 on error and <code>errno</code> is set.
+         *         If <code>rate</code> isn't a standard baud rate,
+         *         <code>errno</code> is set to <code>EINVAL</code>.
          */
         int ispeed (int rate);
 
@@ -80,6 +82,8 @@ namespace iomultiplex {
          * Set the output baud rate.
          * @param rate The output baud rate.
          * @return 0 on success. -1 on error and <code>errno</code> is set.
+         *         If <code>rate</code> isn't a standard baud rate,
+         *         <code>errno</code> is set to <code>EINVAL</code>.
          */
         int ospeed (int rate);
 
@@ -93,9 +97,20 @@ namespace iomultiplex {
          * Set the I/O baud rate.
          * @param rate The I/O baud rate.
          * @return 0 on success. -1 on error and <code>errno</code> is set.
+         *         If <code>rate</code> isn't a standard baud rate,
+         *         <code>errno</code> is set to <code>EINVAL</code>.
          */
         int speed (int rate);
 
+        /**
+         * Check if a baud rate has a standard <code>Bxxx</code> speed value.
+         * Baud rates that are not standard can be set using
+         * SerialConnection::custom_speed.
+         * @param rate A baud rate.
+         * @return <code>true</code> if the baud rate is a standard baud rate.
+         */
+        static bool is_standard_speed (int rate);
+
         /**
          * Get the number of data bits.
          * @return The number of data bits.
@@ -170,6 +185,34 @@ namespace iomultiplex {
          * @param on <code>true</code> for RTS/CTS flow control.
          */
         void rtscts (bool on);
+
+        /**
+         * Get the minimum number of bytes for a non-canonical read (VMIN).
+         * @return The VMIN value.
+         */
+        unsigned vmin ();
+
+        /**
+         * Set the minimum number of bytes for a non-canonical read (VMIN).
+         * When VTIME is 0, the terminal isn't reported readable by
+         * poll/epoll until at least this number of bytes is received.
+         * @param num_bytes The minimum number of bytes (0-255).
+         * @return 0 on success. -1 on error and <code>errno</code> is set.
+         */
+        int vmin (unsigned num_bytes);
+
+        /**
+         * Get the inter-byte timeout for a non-canonical read (VTIME).
+         * @return The VTIME value in deciseconds.
+         */
+        unsigned vtime ();
+
+        /**
+         * Set the inter-byte timeout for a non-canonical read (VTIME).
+         * @param deciseconds Timeout in deciseconds (0-255).
+         * @return 0 on success. -1 on error and <code>errno</code> is set.
+         */
+        int vtime (unsigned deciseconds);
     };
 
 
@@ -28,17 +28,8 @@ namespace iomultiplex {
     std::pair<FdConnection, FdConnection> make_pipe (iohandler_base& ioh, int flags)
     {
         int fd[2];
-        if (pipe(fd) == 0) {
-            int use_flags = O_NONBLOCK | flags;
-            if (fcntl(fd[0], F_SETFD, use_flags) ||
-                fcntl(fd[1], F_SETFD, use_flags))
-            {
-                close (fd[0]);
-                close (fd[1]);
-            }
-        }else{
+        if (pipe2(fd, O_NONBLOCK | flags))
             fd[0] = fd[1] = -1;
-        }
         return std::make_pair(FdConnection(ioh, fd[0]), FdConnection(ioh, fd[1]));
     }
 
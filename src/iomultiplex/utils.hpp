@@ -29,7 +29,15 @@ namespace iomultiplex {
 
 
     /**
-     *
+     * Create a pipe.
+     * The file descriptors of the pipe are opened in non-blocking mode.
+     * @param ioh The I/O handler used by the two pipe connections.
+     * @param flags Additional flags passed to <code>pipe2()</code>,
+     *              like <code>O_CLOEXEC</code> or <code>O_DIRECT</code>.
+     * @return A pair of connections, <code>first</code> is the read
+     *         end of the pipe and <code>second</code> is the write end.
+     *         On failure, both connections are closed and
+     *         <code>errno</code> is set.
      */
     std::pair<FdConnection, FdConnection> make_pipe (iohandler_base& ioh, int flags=0);
 